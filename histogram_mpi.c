@@ -1,7 +1,14 @@
+#include <float.h>
+#include <math.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 // Función para encontrar el bin de un valor
 int find_bin(double value, double *bin_maxes, int bin_count, double min_meas) {
@@ -39,28 +46,1224 @@ int find_bin(double value, double *bin_maxes, int bin_count, double min_meas) {
   return -1; // No debería ocurrir
 }
 
+// ========== BINS UNIFORMES: ÍNDICE O(1) Y SUB-HISTOGRAMAS ==========
+// Con bins de ancho fijo el índice sale de una multiplicación. Se trabaja con
+// "ranuras" s = bin + 1: la ranura 0 recoge valores bajo el mínimo y la
+// ranura bin_count + 1 los que superan el máximo, así el conteo no necesita
+// saltos. Los límites de cada ranura se guardan para corregir en un paso el
+// redondeo de (value - min) / width frente a bin_maxes (el binario decide
+// igual que find_bin en los bordes).
+#define HIST_SUBS 4       // sub-histogramas privados
+#define HIST_BATCH 256    // índices calculados por lote
+#define HIST_POLL 65536   // valores clasificados entre sondeos
+#define HIST_PRINT_MAX 64 // bins que se imprimen como máximo
+
+typedef struct {
+  int bin_count;
+  double min_meas;
+  double inv_width;
+  double *lower; // límite inferior de cada ranura (bin_count + 2)
+  double *upper; // límite superior de cada ranura (bin_count + 2)
+} uniform_bins_t;
+
+void uniform_bins_init(uniform_bins_t *ub, double *bin_maxes, int bin_count,
+                       double min_meas, double bin_width) {
+  int slots = bin_count + 2;
+  ub->bin_count = bin_count;
+  ub->min_meas = min_meas;
+  ub->inv_width = 1.0 / bin_width;
+  ub->lower = (double *)malloc(slots * sizeof(double));
+  ub->upper = (double *)malloc(slots * sizeof(double));
+
+  ub->lower[0] = -INFINITY;
+  ub->upper[0] = min_meas;
+  for (int b = 0; b < bin_count; b++) {
+    ub->lower[b + 1] = (b == 0) ? min_meas : bin_maxes[b - 1];
+    ub->upper[b + 1] = bin_maxes[b];
+  }
+  ub->lower[bin_count + 1] = bin_maxes[bin_count - 1];
+  ub->upper[bin_count + 1] = INFINITY;
+}
+
+void uniform_bins_free(uniform_bins_t *ub) {
+  free(ub->lower);
+  free(ub->upper);
+}
+
+// Ranura de cada valor, sin saltos (el bucle se vectoriza)
+static void uniform_slots(const uniform_bins_t *ub, const double *values,
+                          int count, int *restrict slots) {
+  const double max_slot = ub->bin_count + 1;
+  for (int i = 0; i < count; i++) {
+    double v = values[i];
+    double t = (v - ub->min_meas) * ub->inv_width + 1.0;
+    // NaN (v != v) va a la ranura 0 y se descarta, como el -1 de find_bin;
+    // así nunca se convierte NaN a int
+    t = (t >= 0.0 && v == v) ? t : 0.0;
+    t = t > max_slot ? max_slot : t;
+    int s = (int)t;
+    // +inf se queda en la última ranura (su límite superior también es +inf)
+    s += (v >= ub->upper[s]) & (s <= ub->bin_count);
+    s -= (v < ub->lower[s]);
+    slots[i] = s;
+  }
+}
+
+// Índice del bin como find_bin: -1 por debajo, bin_count por encima
+int find_bin_uniform(const uniform_bins_t *ub, double value) {
+  int slot;
+  uniform_slots(ub, &value, 1, &slot);
+  return slot - 1;
+}
+
+// Función que asigna ranuras (bin + 1) a un lote de valores
+typedef void (*slot_fn_t)(const void *bins, const double *values, int count,
+                          int *restrict slots);
+
+// Sondeo opcional: los núcleos llaman a fn(arg) cada HIST_POLL valores, p. ej.
+// para que MPI avance operaciones pendientes sin partir la clasificación
+typedef struct {
+  void (*fn)(void *arg);
+  void *arg;
+} hist_poll_t;
+
+static void uniform_slots_fn(const void *bins, const double *values, int count,
+                             int *restrict slots) {
+  uniform_slots((const uniform_bins_t *)bins, values, count, slots);
+}
+
+// Suma en bin_counts el histograma de values. Elementos consecutivos van a
+// sub-histogramas distintos: si muchos valores caen en el mismo bin, los
+// incrementos no se encadenan (store-to-load) sobre la misma posición.
+static void histogram_slots(slot_fn_t slot_fn, const void *bins, int bin_count,
+                            const double *values, int count,
+                            long long int *bin_counts,
+                            const hist_poll_t *poll) {
+  int slots_per_sub = bin_count + 2;
+  int *sub = (int *)calloc(HIST_SUBS * slots_per_sub, sizeof(int));
+  int *sub0 = sub, *sub1 = sub + slots_per_sub;
+  int *sub2 = sub + 2 * slots_per_sub, *sub3 = sub + 3 * slots_per_sub;
+  int slots[HIST_BATCH];
+  int since_poll = 0;
+
+  for (int done = 0; done < count; done += HIST_BATCH) {
+    int batch = (count - done < HIST_BATCH) ? count - done : HIST_BATCH;
+    slot_fn(bins, values + done, batch, slots);
+    since_poll += batch;
+    if (poll != NULL && since_poll >= HIST_POLL) {
+      poll->fn(poll->arg);
+      since_poll = 0;
+    }
+
+    int i = 0;
+    for (; i + HIST_SUBS <= batch; i += HIST_SUBS) {
+      sub0[slots[i]]++;
+      sub1[slots[i + 1]]++;
+      sub2[slots[i + 2]]++;
+      sub3[slots[i + 3]]++;
+    }
+    for (; i < batch; i++) {
+      sub0[slots[i]]++;
+    }
+  }
+
+  // Combinar sub-histogramas; se descartan las ranuras fuera de rango
+  for (int b = 0; b < bin_count; b++) {
+    bin_counts[b] += sub0[b + 1] + sub1[b + 1] + sub2[b + 1] + sub3[b + 1];
+  }
+  free(sub);
+}
+
+void histogram_uniform(const uniform_bins_t *ub, const double *values,
+                       int count, long long int *bin_counts,
+                       const hist_poll_t *poll) {
+  histogram_slots(uniform_slots_fn, ub, ub->bin_count, values, count,
+                  bin_counts, poll);
+}
+
+// ========== BINS NO UNIFORMES: BÚSQUEDA EYTZINGER SIN SALTOS ==========
+// Para límites arbitrarios (escala log, cuantiles) sigue haciendo falta una
+// búsqueda, pero find_bin salta de forma impredecible y recorre la memoria
+// sin localidad. Aquí bin_maxes se guarda en orden BFS (Eytzinger): los
+// primeros niveles del árbol comparten pocas líneas de caché y los
+// descendientes a 3 niveles de un nodo k (8k..8k+7) ocupan una sola línea,
+// que se precarga. El árbol se completa con +inf hasta 2^depth - 1 nodos,
+// así todas las búsquedas dan exactamente depth pasos sin saltos y se
+// intercalan EYTZ_GROUP búsquedas independientes para solapar sus fallos.
+#define EYTZ_GROUP 8
+
+typedef struct {
+  int bin_count;
+  int depth;       // niveles del árbol completo
+  int nodes;       // 2^depth - 1
+  double min_meas;
+  double *tree;    // tree[1..nodes] en orden BFS (tree[0] sin uso)
+  int *slot_of;    // nodo encontrado -> ranura (bin + 1)
+} eytzinger_bins_t;
+
+// Recorrido en orden: asigna los límites ordenados a las posiciones BFS
+static int eytzinger_fill(eytzinger_bins_t *eb, const double *bin_maxes,
+                          int *rank_of, int next, int k) {
+  if (k <= eb->nodes) {
+    next = eytzinger_fill(eb, bin_maxes, rank_of, next, 2 * k);
+    eb->tree[k] = next < eb->bin_count ? bin_maxes[next] : INFINITY;
+    rank_of[k] = next++;
+    next = eytzinger_fill(eb, bin_maxes, rank_of, next, 2 * k + 1);
+  }
+  return next;
+}
+
+void eytzinger_bins_init(eytzinger_bins_t *eb, const double *bin_maxes,
+                         int bin_count, double min_meas) {
+  eb->bin_count = bin_count;
+  eb->min_meas = min_meas;
+  eb->depth = 0;
+  while ((1 << eb->depth) - 1 < bin_count) {
+    eb->depth++;
+  }
+  eb->nodes = (1 << eb->depth) - 1;
+
+  // tree alineado a 64 bytes: tree[8k..8k+7] cae en una sola línea
+  size_t tree_bytes = ((eb->nodes + 1) * sizeof(double) + 63) / 64 * 64;
+  eb->tree = (double *)aligned_alloc(64, tree_bytes);
+  eb->tree[0] = NAN;
+  eb->slot_of = (int *)malloc((eb->nodes + 1) * sizeof(int));
+
+  int *rank_of = (int *)malloc((eb->nodes + 1) * sizeof(int));
+  eytzinger_fill(eb, bin_maxes, rank_of, 0, 1);
+
+  // El nodo 0 indica "ningún límite supera al valor": por encima del máximo.
+  // Si no, la posición ordenada del primer límite mayor es el bin.
+  eb->slot_of[0] = bin_count + 1;
+  for (int k = 1; k <= eb->nodes; k++) {
+    eb->slot_of[k] = (rank_of[k] < bin_count ? rank_of[k] : bin_count) + 1;
+  }
+  free(rank_of);
+}
+
+void eytzinger_bins_free(eytzinger_bins_t *eb) {
+  free(eb->tree);
+  free(eb->slot_of);
+}
+
+// Ranuras de group (<= EYTZ_GROUP) valores, en pasos intercalados
+static inline void eytzinger_group(const eytzinger_bins_t *eb,
+                                   const double *values, int group,
+                                   int *restrict slots) {
+  const double *tree = eb->tree;
+  unsigned int k[EYTZ_GROUP];
+  for (int j = 0; j < group; j++) {
+    k[j] = 1;
+  }
+
+  int prefetch_levels = eb->depth - 3;
+  for (int level = 0; level < eb->depth; level++) {
+    if (level < prefetch_levels) {
+      for (int j = 0; j < group; j++) {
+        __builtin_prefetch(tree + 8 * k[j]);
+      }
+    }
+    for (int j = 0; j < group; j++) {
+      k[j] = 2 * k[j] + (tree[k[j]] <= values[j]);
+    }
+  }
+
+  for (int j = 0; j < group; j++) {
+    // Quitar los giros a la derecha finales: queda el primer límite > valor
+    unsigned int node = k[j] >> __builtin_ffs(~k[j]);
+    int slot = eb->slot_of[node];
+    slots[j] = (values[j] >= eb->min_meas) ? slot : 0;
+  }
+}
+
+static void eytzinger_slots(const void *bins, const double *values, int count,
+                            int *restrict slots) {
+  const eytzinger_bins_t *eb = (const eytzinger_bins_t *)bins;
+  int i = 0;
+  for (; i + EYTZ_GROUP <= count; i += EYTZ_GROUP) {
+    eytzinger_group(eb, values + i, EYTZ_GROUP, slots + i);
+  }
+  if (i < count) {
+    eytzinger_group(eb, values + i, count - i, slots + i);
+  }
+}
+
+// Índice del bin como find_bin: -1 por debajo, bin_count por encima
+int find_bin_eytzinger(const eytzinger_bins_t *eb, double value) {
+  int slot;
+  eytzinger_group(eb, &value, 1, &slot);
+  return slot - 1;
+}
+
+void histogram_eytzinger(const eytzinger_bins_t *eb, const double *values,
+                         int count, long long int *bin_counts,
+                         const hist_poll_t *poll) {
+  histogram_slots(eytzinger_slots, eb, eb->bin_count, values, count,
+                  bin_counts, poll);
+}
+
+// ========== DISPOSICIÓN DE LOS BINS ==========
+// Agrupa lo necesario para clasificar valores: límites para la búsqueda
+// binaria y la tabla del índice aritmético (bins uniformes) o el árbol
+// Eytzinger (límites arbitrarios).
+typedef struct {
+  int bin_count;
+  double min_meas;
+  double *bin_maxes;
+  uniform_bins_t *uniform;     // NULL si los límites no son uniformes
+  eytzinger_bins_t *eytzinger; // NULL: se usa find_bin
+  int num_threads;             // hilos para la clasificación local
+  const hist_poll_t *poll;     // NULL: sin sondeo
+} bin_layout_t;
+
+// Valores por llamada a los núcleos, que cuentan con int: un tramo local
+// de más de 2^31 doubles se procesa por trozos
+#ifndef KERNEL_CHUNK
+#define KERNEL_CHUNK (1 << 30)
+#endif
+
+// Suma en bin_counts el histograma de values con la ruta que corresponda;
+// poll se pasa aparte porque con hilos solo sondea el hilo maestro
+static void local_histogram_serial(const bin_layout_t *layout,
+                                   const double *values, long long int count,
+                                   long long int *bin_counts,
+                                   const hist_poll_t *poll) {
+  if (layout->uniform != NULL || layout->eytzinger != NULL) {
+    for (long long int done = 0; done < count; done += KERNEL_CHUNK) {
+      int n = count - done < KERNEL_CHUNK ? (int)(count - done) : KERNEL_CHUNK;
+      if (layout->uniform != NULL) {
+        // Bins uniformes: índice aritmético + sub-histogramas
+        histogram_uniform(layout->uniform, values + done, n, bin_counts,
+                          poll);
+      } else {
+        // Límites arbitrarios: búsqueda Eytzinger intercalada
+        histogram_eytzinger(layout->eytzinger, values + done, n, bin_counts,
+                            poll);
+      }
+    }
+  } else {
+    // Búsqueda binaria de referencia
+    for (long long int i = 0; i < count; i++) {
+      int bin = find_bin(values[i], layout->bin_maxes, layout->bin_count,
+                         layout->min_meas);
+      if (bin >= 0 && bin < layout->bin_count) {
+        bin_counts[bin]++;
+      }
+      if (poll != NULL && (i + 1) % HIST_POLL == 0) {
+        poll->fn(poll->arg);
+      }
+    }
+  }
+}
+
+// Versión con hilos: cada hilo clasifica un tramo contiguo de values en su
+// propio histograma (alineado y de tamaño múltiplo de la línea de caché,
+// sin false sharing) y después se combinan en árbol: en el paso s el hilo t
+// suma el histograma de t + s, con log2(hilos) pasos en paralelo. Así un
+// solo proceso por nodo usa todos los núcleos y la reducción MPI sigue
+// siendo una por proceso.
+#define CACHE_LINE 64
+
+void local_histogram(const bin_layout_t *layout, const double *values,
+                     long long int count, long long int *bin_counts) {
+  int num_threads = layout->num_threads;
+  if (num_threads <= 1 || count < num_threads) {
+    local_histogram_serial(layout, values, count, bin_counts, layout->poll);
+    return;
+  }
+
+  int bin_count = layout->bin_count;
+  size_t per_line = CACHE_LINE / sizeof(long long int);
+  size_t stride = (bin_count + per_line - 1) / per_line * per_line;
+  long long int *private_counts = (long long int *)aligned_alloc(
+      CACHE_LINE, num_threads * stride * sizeof(long long int));
+
+#pragma omp parallel num_threads(num_threads)
+  {
+#ifdef _OPENMP
+    int tid = omp_get_thread_num();
+#else
+    int tid = 0;
+#endif
+    long long int base = count / num_threads, extra = count % num_threads;
+    long long int my_count = base + (tid < extra ? 1 : 0);
+    long long int my_first = tid * base + (tid < extra ? tid : extra);
+
+    long long int *mine = private_counts + tid * stride;
+    memset(mine, 0, stride * sizeof(long long int));
+    // MPI_THREAD_FUNNELED: solo el hilo maestro puede llamar a MPI
+    local_histogram_serial(layout, values + my_first, my_count, mine,
+                           tid == 0 ? layout->poll : NULL);
+
+    // Combinación en árbol
+    for (int step = 1; step < num_threads; step *= 2) {
+#pragma omp barrier
+      if (tid % (2 * step) == 0 && tid + step < num_threads) {
+        const long long int *other = private_counts + (tid + step) * stride;
+        for (int b = 0; b < bin_count; b++) {
+          mine[b] += other[b];
+        }
+      }
+    }
+  }
+
+  for (int b = 0; b < bin_count; b++) {
+    bin_counts[b] += private_counts[b];
+  }
+  free(private_counts);
+}
+
+// ========== LECTURA PARALELA DE ARCHIVOS BINARIOS ==========
+// El archivo es una secuencia de doubles nativos. Cada proceso lee solo su
+// tramo contiguo, así el tamaño del conjunto no depende de la memoria del
+// proceso 0 ni pasa por él.
+#define READ_CHUNK (1 << 27) // doubles por llamada colectiva (1 GiB)
+
+// Lee [first, first + count) con MPI_File_read_at_all. Las llamadas son
+// colectivas, así que todos hacen las mismas rondas (según max_count) aunque
+// su tramo sea más corto o esté vacío.
+void read_slice_mpiio(MPI_File fh, long long int first, long long int count,
+                      long long int max_count, double *buffer) {
+  for (long long int done = 0; done < max_count; done += READ_CHUNK) {
+    long long int left = count - done;
+    int n = left <= 0 ? 0 : (left < READ_CHUNK ? (int)left : READ_CHUNK);
+    MPI_Offset offset = (MPI_Offset)(first + (n > 0 ? done : 0)) *
+                        (MPI_Offset)sizeof(double);
+    MPI_File_read_at_all(fh, offset, buffer + (n > 0 ? done : 0), n,
+                         MPI_DOUBLE, MPI_STATUS_IGNORE);
+  }
+}
+
+// Proyecta en memoria [first, first + count) del archivo (sistema de
+// archivos compartido). mmap exige un desplazamiento múltiplo de página.
+double *map_slice(const char *path, long long int first, long long int count,
+                  void **map_base, size_t *map_length) {
+  *map_base = NULL;
+  *map_length = 0;
+  if (count == 0) {
+    return NULL;
+  }
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  long page = sysconf(_SC_PAGESIZE);
+  off_t begin = (off_t)first * (off_t)sizeof(double);
+  off_t aligned = begin - begin % page;
+  size_t length = (size_t)(begin - aligned) + (size_t)count * sizeof(double);
+
+  void *base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(file),
+                    aligned);
+  fclose(file);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  madvise(base, length, MADV_SEQUENTIAL);
+
+  *map_base = base;
+  *map_length = length;
+  return (double *)((char *)base + (begin - aligned));
+}
+
+// ========== MODO FLUJO CON VENTANAS ==========
+// El archivo se consume como un flujo en pasos: en el paso s el proceso r
+// lee los chunk valores que empiezan en (s * size + r) * chunk. Mientras se
+// clasifica el paso s ya están en vuelo la lectura del paso s + 1
+// (MPI_File_iread_at) y la reducción del paso s - 1 (MPI_Ireduce), así la
+// E/S y la comunicación quedan ocultas tras el cálculo.
+// El proceso 0 guarda los histogramas de los últimos 'window' pasos en un
+// anillo: en ventana deslizante resta el paso que caduca; en ventana fija
+// (tumbling) emite y vacía la ventana cada 'window' pasos. La memoria queda
+// acotada a (window + 2) histogramas sin importar la longitud del flujo.
+typedef struct {
+  int window;   // pasos por ventana
+  int tumbling; // 1: ventanas fijas, 0: deslizante
+  int bin_count;
+  long long int *ring;   // window histogramas de paso (solo proceso 0)
+  long long int *counts; // histograma de la ventana actual (solo proceso 0)
+  int clear_pending;
+} stream_window_t;
+
+// Incorpora al acumulado de la ventana el paso 'step' (ya reducido en el
+// anillo) y emite una línea cuando corresponde
+static void window_fold(stream_window_t *w, int step, int last_step) {
+  long long int *step_counts =
+      w->ring + (size_t)(step % w->window) * w->bin_count;
+  if (w->clear_pending) {
+    memset(w->counts, 0, w->bin_count * sizeof(long long int));
+    w->clear_pending = 0;
+  }
+  for (int b = 0; b < w->bin_count; b++) {
+    w->counts[b] += step_counts[b];
+  }
+
+  int full = w->tumbling ? (step + 1) % w->window == 0 : step + 1 >= w->window;
+  if (!full && !last_step) {
+    return;
+  }
+  long long int total = 0;
+  int mode_bin = 0;
+  for (int b = 0; b < w->bin_count; b++) {
+    total += w->counts[b];
+    if (w->counts[b] > w->counts[mode_bin]) {
+      mode_bin = b;
+    }
+  }
+  int first_step = w->tumbling ? step - step % w->window
+                               : (step + 1 > w->window ? step + 1 - w->window
+                                                       : 0);
+  printf("Ventana pasos %d-%d: %lld elementos, bin más frecuente %d (%lld)\n",
+         first_step, step, total, mode_bin, w->counts[mode_bin]);
+  if (w->tumbling) {
+    w->clear_pending = 1;
+  }
+}
+
+// Sondeo de stream_histogram: MPI_Test de la reducción y la lectura en curso
+typedef struct {
+  MPI_Request *reduce;
+  MPI_Request *read;
+} stream_pending_t;
+
+static void stream_poll(void *arg) {
+  stream_pending_t *pending = (stream_pending_t *)arg;
+  int flag;
+  MPI_Test(pending->reduce, &flag, MPI_STATUS_IGNORE);
+  MPI_Test(pending->read, &flag, MPI_STATUS_IGNORE);
+}
+
+// Procesa el archivo completo en modo flujo. local_totals acumula todo lo
+// que clasificó este proceso; en el proceso 0, window_counts recibe la
+// última ventana. Devuelve los elementos leídos por este proceso.
+long long int stream_histogram(MPI_File fh, long long int data_count,
+                               int chunk, int window, int tumbling,
+                               const bin_layout_t *layout,
+                               long long int *local_totals,
+                               long long int *window_counts, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  int bin_count = layout->bin_count;
+
+  long long int per_step = (long long int)chunk * size;
+  int steps = (int)((data_count + per_step - 1) / per_step);
+
+  double *buffer[2];
+  long long int *step_counts[2];
+  MPI_Request read_request[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+  MPI_Request reduce_request = MPI_REQUEST_NULL;
+  for (int k = 0; k < 2; k++) {
+    buffer[k] = (double *)malloc(chunk * sizeof(double));
+    step_counts[k] =
+        (long long int *)malloc(bin_count * sizeof(long long int));
+  }
+
+  // Los núcleos sondean cada HIST_POLL valores dentro de una sola llamada:
+  // los histogramas privados y los sub-histogramas se preparan una vez por
+  // paso, no una vez por sondeo
+  stream_pending_t pending = {&reduce_request, NULL};
+  hist_poll_t poll = {stream_poll, &pending};
+  bin_layout_t polled = *layout;
+  polled.poll = &poll;
+
+  stream_window_t w = {window, tumbling, bin_count, NULL, window_counts, 0};
+  if (rank == 0) {
+    w.ring = (long long int *)calloc((size_t)window * bin_count,
+                                     sizeof(long long int));
+    memset(window_counts, 0, bin_count * sizeof(long long int));
+  }
+
+  // Valores del paso s que le tocan a este proceso
+  long long int first_of_step[2];
+  int count_of_step[2];
+#define STREAM_SLICE(s, k)                                                     \
+  do {                                                                         \
+    first_of_step[k] = ((long long int)(s) * size + rank) * chunk;             \
+    long long int left = data_count - first_of_step[k];                        \
+    count_of_step[k] = left <= 0 ? 0 : (left < chunk ? (int)left : chunk);     \
+  } while (0)
+
+  long long int processed = 0;
+  if (steps > 0) {
+    STREAM_SLICE(0, 0);
+    MPI_File_iread_at(fh, first_of_step[0] * (MPI_Offset)sizeof(double),
+                      buffer[0], count_of_step[0], MPI_DOUBLE,
+                      &read_request[0]);
+  }
+
+  for (int s = 0; s < steps; s++) {
+    int cur = s % 2, next = 1 - cur;
+
+    MPI_Wait(&read_request[cur], MPI_STATUS_IGNORE);
+    if (s + 1 < steps) {
+      STREAM_SLICE(s + 1, next);
+      MPI_File_iread_at(fh, first_of_step[next] * (MPI_Offset)sizeof(double),
+                        buffer[next], count_of_step[next], MPI_DOUBLE,
+                        &read_request[next]);
+    }
+
+    // Clasificar el paso s mientras la reducción del paso s - 1 avanza. Sin
+    // hilo de progreso MPI solo avanza dentro de llamadas a MPI: el núcleo
+    // hace MPI_Test de la reducción y de la lectura pendientes.
+    memset(step_counts[cur], 0, bin_count * sizeof(long long int));
+    pending.read = &read_request[next];
+    local_histogram(&polled, buffer[cur], count_of_step[cur],
+                    step_counts[cur]);
+    for (int b = 0; b < bin_count; b++) {
+      local_totals[b] += step_counts[cur][b];
+    }
+    processed += count_of_step[cur];
+
+    MPI_Wait(&reduce_request, MPI_STATUS_IGNORE);
+    long long int *slot = NULL;
+    if (rank == 0) {
+      if (s > 0) {
+        window_fold(&w, s - 1, 0);
+      }
+      slot = w.ring + (size_t)(s % window) * bin_count;
+      // Ventana deslizante: el paso s - window caduca al reutilizar su hueco
+      if (!tumbling && s >= window) {
+        for (int b = 0; b < bin_count; b++) {
+          w.counts[b] -= slot[b];
+        }
+      }
+    }
+    MPI_Ireduce(step_counts[cur], slot, bin_count, MPI_LONG_LONG_INT, MPI_SUM,
+                0, comm, &reduce_request);
+  }
+#undef STREAM_SLICE
+
+  MPI_Wait(&reduce_request, MPI_STATUS_IGNORE);
+  if (rank == 0 && steps > 0) {
+    window_fold(&w, steps - 1, 1);
+  }
+
+  for (int k = 0; k < 2; k++) {
+    free(buffer[k]);
+    free(step_counts[k]);
+  }
+  free(w.ring);
+  return processed;
+}
+
+// ========== REDUCCIÓN DE HISTOGRAMAS GRANDES ==========
+// Con millones de bins el MPI_Reduce denso a rank 0 envía sobre todo ceros y
+// deja toda la salida en un proceso. Alternativas:
+//  - REDUCE_SCATTER: MPI_Reduce_scatter_block; cada proceso se queda con un
+//    tramo contiguo de bins y ningún proceso guarda el histograma completo.
+//  - REDUCE_SPARSE: cada proceso envía solo pares (bin, cuenta) no nulos por
+//    un árbol binomial (como tree_sum.c) que mezcla las listas ordenadas.
+//  - REDUCE_AUTO: disperso si la ocupación total (suma de bins no nulos de
+//    todos los procesos) cabe en la mitad de los bins; así ninguna lista de
+//    pares ocupa más que el histograma denso. Si no, MPI_Reduce denso.
+typedef enum {
+  REDUCE_AUTO,
+  REDUCE_ROOT,
+  REDUCE_SCATTER,
+  REDUCE_SPARSE
+} reduce_mode_t;
+
+typedef struct {
+  long long int bin;
+  long long int count;
+} sparse_bin_t;
+
+// Pares (bin, cuenta) no nulos de counts, ordenados por bin
+long long int sparse_encode(const long long int *counts, int bin_count,
+                            sparse_bin_t *pairs) {
+  long long int nnz = 0;
+  for (int b = 0; b < bin_count; b++) {
+    if (counts[b] != 0) {
+      pairs[nnz].bin = b;
+      pairs[nnz].count = counts[b];
+      nnz++;
+    }
+  }
+  return nnz;
+}
+
+// Mezcla dos listas ordenadas sumando las cuentas de bins repetidos
+long long int sparse_merge(const sparse_bin_t *a, long long int na,
+                           const sparse_bin_t *b, long long int nb,
+                           sparse_bin_t *out) {
+  long long int i = 0, j = 0, k = 0;
+  while (i < na && j < nb) {
+    if (a[i].bin < b[j].bin) {
+      out[k++] = a[i++];
+    } else if (b[j].bin < a[i].bin) {
+      out[k++] = b[j++];
+    } else {
+      out[k].bin = a[i].bin;
+      out[k++].count = a[i++].count + b[j++].count;
+    }
+  }
+  while (i < na)
+    out[k++] = a[i++];
+  while (j < nb)
+    out[k++] = b[j++];
+  return k;
+}
+
+// Reduce los histogramas locales a global_counts (rank 0) con listas dispersas
+void sparse_reduce(const long long int *local_counts, int bin_count,
+                   long long int *global_counts, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  MPI_Datatype pair_type;
+  MPI_Type_contiguous(2, MPI_LONG_LONG_INT, &pair_type);
+  MPI_Type_commit(&pair_type);
+
+  // Las listas nunca superan bin_count pares
+  sparse_bin_t *list =
+      (sparse_bin_t *)malloc(bin_count * sizeof(sparse_bin_t));
+  sparse_bin_t *partner =
+      (sparse_bin_t *)malloc(bin_count * sizeof(sparse_bin_t));
+  sparse_bin_t *merged =
+      (sparse_bin_t *)malloc(bin_count * sizeof(sparse_bin_t));
+  long long int nnz = sparse_encode(local_counts, bin_count, list);
+
+  for (int step = 1; step < size; step *= 2) {
+    if (rank & step) {
+      // Emisor: entrega su lista y termina
+      MPI_Send(list, (int)nnz, pair_type, rank - step, 0, comm);
+      break;
+    } else if (rank + step < size) {
+      // Receptor: el tamaño llega con el propio mensaje
+      MPI_Status status;
+      int partner_nnz;
+      MPI_Probe(rank + step, 0, comm, &status);
+      MPI_Get_count(&status, pair_type, &partner_nnz);
+      MPI_Recv(partner, partner_nnz, pair_type, rank + step, 0, comm,
+               MPI_STATUS_IGNORE);
+
+      nnz = sparse_merge(list, nnz, partner, partner_nnz, merged);
+      sparse_bin_t *tmp = list;
+      list = merged;
+      merged = tmp;
+    }
+  }
+
+  if (rank == 0) {
+    memset(global_counts, 0, bin_count * sizeof(long long int));
+    for (long long int i = 0; i < nnz; i++) {
+      global_counts[list[i].bin] = list[i].count;
+    }
+  }
+
+  free(list);
+  free(partner);
+  free(merged);
+  MPI_Type_free(&pair_type);
+}
+
+// Bins por proceso en REDUCE_SCATTER (el último tramo puede quedar corto)
+int scatter_block_size(int bin_count, int size) {
+  return (bin_count + size - 1) / size;
+}
+
+// Cada proceso recibe en owned_counts la suma global de sus
+// scatter_block_size() bins, empezando en rank * block
+void scatter_reduce(const long long int *local_counts, int bin_count,
+                    long long int *owned_counts, MPI_Comm comm) {
+  int size;
+  MPI_Comm_size(comm, &size);
+  int block = scatter_block_size(bin_count, size);
+
+  // MPI_Reduce_scatter_block exige size * block elementos
+  const long long int *send = local_counts;
+  long long int *padded = NULL;
+  if ((long long int)block * size != bin_count) {
+    padded = (long long int *)calloc((size_t)block * size,
+                                     sizeof(long long int));
+    memcpy(padded, local_counts, bin_count * sizeof(long long int));
+    send = padded;
+  }
+  MPI_Reduce_scatter_block(send, owned_counts, block, MPI_LONG_LONG_INT,
+                           MPI_SUM, comm);
+  free(padded);
+}
+
+// ========== LÍMITES NO UNIFORMES ==========
+// Lee bin_count + 1 límites ascendentes (uno por línea) de un archivo de
+// texto: el primero es min_meas, el último max_meas y el resto separa bins.
+double *read_edges(const char *path, int *bin_count, double *min_meas,
+                   double *max_meas) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return NULL;
+  }
+  int capacity = 1024, count = 0;
+  double *edges = (double *)malloc(capacity * sizeof(double));
+  double value;
+  while (fscanf(file, "%lf", &value) == 1) {
+    if (count > 0 && value <= edges[count - 1]) {
+      count = 0; // límites no crecientes
+      break;
+    }
+    if (count == capacity) {
+      capacity *= 2;
+      edges = (double *)realloc(edges, capacity * sizeof(double));
+    }
+    edges[count++] = value;
+  }
+  fclose(file);
+  if (count < 2) {
+    free(edges);
+    return NULL;
+  }
+
+  *bin_count = count - 1;
+  *min_meas = edges[0];
+  *max_meas = edges[count - 1];
+  double *bin_maxes = (double *)malloc((count - 1) * sizeof(double));
+  memcpy(bin_maxes, edges + 1, (count - 1) * sizeof(double));
+  free(edges);
+  return bin_maxes;
+}
+
+// Límites en escala logarítmica entre min_meas > 0 y max_meas
+void log_bin_maxes(double *bin_maxes, int bin_count, double min_meas,
+                   double max_meas) {
+  double ratio = log(max_meas / min_meas) / bin_count;
+  for (int b = 0; b < bin_count - 1; b++) {
+    bin_maxes[b] = min_meas * exp(ratio * (b + 1));
+  }
+  bin_maxes[bin_count - 1] = max_meas;
+}
+
+// ========== BENCHMARK DE BÚSQUEDA NO UNIFORME ==========
+// Compara find_bin con la búsqueda Eytzinger sobre límites aleatorios
+// (ordenados) de 16 a 1M bins; comprueba que los histogramas coinciden.
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// Comprueba valor a valor que el índice uniforme y la búsqueda Eytzinger
+// clasifican igual que find_bin sobre bins uniformes de [min, max): valores
+// aleatorios, los límites exactos y valores no finitos (NaN y -inf se
+// descartan, +inf queda por encima del máximo). Devuelve las diferencias.
+static int check_bin_equivalence(int bin_count, double min_meas,
+                                 double max_meas) {
+  const double special[] = {NAN, -NAN, INFINITY, -INFINITY, -0.0, 0.0,
+                            min_meas, max_meas, DBL_MAX, -DBL_MAX};
+  int special_count = sizeof(special) / sizeof(special[0]);
+  int value_count = special_count + bin_count + 10000;
+  double *values = (double *)malloc(value_count * sizeof(double));
+  double *bin_maxes = (double *)malloc(bin_count * sizeof(double));
+  double bin_width = (max_meas - min_meas) / bin_count;
+  for (int b = 0; b < bin_count; b++) {
+    bin_maxes[b] = min_meas + bin_width * (b + 1);
+  }
+  memcpy(values, special, sizeof(special));
+  memcpy(values + special_count, bin_maxes, bin_count * sizeof(double));
+  for (int i = special_count + bin_count; i < value_count; i++) {
+    values[i] = min_meas - bin_width +
+                (max_meas - min_meas + 2 * bin_width) * rand() / RAND_MAX;
+  }
+
+  uniform_bins_t ub;
+  eytzinger_bins_t eb;
+  uniform_bins_init(&ub, bin_maxes, bin_count, min_meas, bin_width);
+  eytzinger_bins_init(&eb, bin_maxes, bin_count, min_meas);
+  int mismatches = 0;
+  for (int i = 0; i < value_count; i++) {
+    int bin = find_bin(values[i], bin_maxes, bin_count, min_meas);
+    mismatches += find_bin_uniform(&ub, values[i]) != bin;
+    mismatches += find_bin_eytzinger(&eb, values[i]) != bin;
+  }
+  uniform_bins_free(&ub);
+  eytzinger_bins_free(&eb);
+  free(values);
+  free(bin_maxes);
+  return mismatches;
+}
+
+void benchmark_bin_search(void) {
+  const int value_count = 1 << 22;
+  int mismatches = check_bin_equivalence(10, 0.0, 5.0) +
+                   check_bin_equivalence(1000, -1.0, 1.0) +
+                   check_bin_equivalence(4096, 0.0, 1.0);
+  printf("=== EQUIVALENCIA CON find_bin (NaN, ±inf, límites) ===\n%s\n\n",
+         mismatches == 0 ? "Uniforme y Eytzinger: idénticos"
+                         : "Uniforme o Eytzinger: DIFERENTE");
+
+  double *values = (double *)malloc(value_count * sizeof(double));
+  srand(12345);
+  // 10% de los valores fuera de [0, 1) para ejercitar los extremos
+  for (int i = 0; i < value_count; i++) {
+    values[i] = -0.05 + 1.1 * ((double)rand() / RAND_MAX);
+  }
+
+  printf("=== BENCHMARK: find_bin vs Eytzinger (%d valores) ===\n",
+         value_count);
+  printf("%10s %16s %16s %9s\n", "bins", "find_bin Mv/s", "eytzinger Mv/s",
+         "speedup");
+
+  for (int bin_count = 16; bin_count <= (1 << 20); bin_count *= 4) {
+    double *bin_maxes = (double *)malloc(bin_count * sizeof(double));
+    for (int b = 0; b < bin_count - 1; b++) {
+      bin_maxes[b] = (double)rand() / RAND_MAX;
+    }
+    qsort(bin_maxes, bin_count - 1, sizeof(double), compare_doubles);
+    bin_maxes[bin_count - 1] = 1.0;
+
+    long long int *reference =
+        (long long int *)calloc(bin_count, sizeof(long long int));
+    long long int *counts =
+        (long long int *)calloc(bin_count, sizeof(long long int));
+
+    double start = MPI_Wtime();
+    for (int i = 0; i < value_count; i++) {
+      int bin = find_bin(values[i], bin_maxes, bin_count, 0.0);
+      if (bin >= 0 && bin < bin_count) {
+        reference[bin]++;
+      }
+    }
+    double binary_time = MPI_Wtime() - start;
+
+    eytzinger_bins_t eb;
+    eytzinger_bins_init(&eb, bin_maxes, bin_count, 0.0);
+    start = MPI_Wtime();
+    histogram_eytzinger(&eb, values, value_count, counts, NULL);
+    double eytzinger_time = MPI_Wtime() - start;
+    eytzinger_bins_free(&eb);
+
+    int same = memcmp(reference, counts, bin_count * sizeof(long long int));
+    printf("%10d %16.1f %16.1f %8.2fx%s\n", bin_count,
+           value_count / binary_time / 1e6, value_count / eytzinger_time / 1e6,
+           binary_time / eytzinger_time, same == 0 ? "" : "  DIFERENTE");
+
+    free(bin_maxes);
+    free(reference);
+    free(counts);
+  }
+  free(values);
+}
+
+// ========== CUANTILES DISTRIBUIDOS ==========
+// Cuantiles exactos sin mover los datos: en cada ronda se hace un histograma
+// global de QUANTILE_BINS bins sobre [min, max] de los candidatos, se elige
+// el bin que contiene el rango buscado y cada proceso se queda solo con sus
+// valores de ese bin. Cuando quedan QUANTILE_BINS candidatos o menos en
+// total, se reúnen (Allgatherv) y se ordenan. Con n = 10^9 bastan unas tres
+// rondas: la comunicación es O(bins) por ronda en lugar de O(n).
+// Los candidatos se eligen con el mismo índice entero con el que se cuentan,
+// así el redondeo de los límites no puede perder valores. NaN no tiene
+// orden y se ignora; -inf y +inf se cuentan aparte (ocupan los extremos) y
+// solo los valores finitos son candidatos.
+#define QUANTILE_BINS 1024
+
+// Bin de un valor finito de [lo, hi]. Si hi - lo desborda (p. ej. -DBL_MAX
+// y DBL_MAX) se trabaja con mitades (scale = 0.5); si no, scale = 1 y la
+// resta es exacta también con subnormales. El índice se acota a
+// [0, QUANTILE_BINS - 1] y un NaN intermedio (0 * inf) cae en el bin 0.
+static inline int quantile_bin(double value, double lo, double scale,
+                               double inv_width) {
+  double t = (scale * value - scale * lo) * inv_width;
+  if (!(t >= 0.0)) {
+    return 0;
+  }
+  return t < QUANTILE_BINS ? (int)t : QUANTILE_BINS - 1;
+}
+
+// Cuantil q (rango más cercano: posición floor(q * (N - 1)) en orden) de la
+// unión de los values de todos los procesos de comm
+double distributed_quantile(const double *values, long long int count,
+                            double q, MPI_Comm comm, int *rounds) {
+  // Valores finitos, NaN, -inf y +inf de este proceso y globales
+  long long int local_kinds[4] = {0, 0, 0, 0}, kinds[4];
+  for (long long int i = 0; i < count; i++) {
+    double v = values[i];
+    local_kinds[isfinite(v) ? 0 : (isnan(v) ? 1 : (v < 0 ? 2 : 3))]++;
+  }
+  MPI_Allreduce(local_kinds, kinds, 4, MPI_LONG_LONG_INT, MPI_SUM, comm);
+  *rounds = 0;
+  long long int ordered = kinds[0] + kinds[2] + kinds[3];
+  if (ordered == 0) {
+    return NAN;
+  }
+  long long int target = (long long int)floor(q * (ordered - 1));
+  if (target < kinds[2]) {
+    return -INFINITY;
+  }
+  if (target >= kinds[2] + kinds[0]) {
+    return INFINITY;
+  }
+  target -= kinds[2]; // rango entre los valores finitos
+  long long int total = kinds[0];
+
+  const double *candidates = values; // candidatos locales
+  double *owned = NULL;              // copia propia (solo valores finitos)
+  long long int local_count = count;
+  if (local_kinds[0] != count) {
+    owned = (double *)malloc((local_kinds[0] + 1) * sizeof(double));
+    local_count = 0;
+    for (long long int i = 0; i < count; i++) {
+      if (isfinite(values[i])) {
+        owned[local_count++] = values[i];
+      }
+    }
+    candidates = owned;
+  }
+  long long int below = 0; // valores globales a la izquierda del bin
+  long long int *local_hist =
+      (long long int *)malloc(QUANTILE_BINS * sizeof(long long int));
+  long long int *global_hist =
+      (long long int *)malloc(QUANTILE_BINS * sizeof(long long int));
+  double result = NAN;
+  int done = 0;
+
+  while (total > QUANTILE_BINS) {
+    // [min, max] global de los candidatos: un solo Allreduce con MPI_MIN
+    double extremes[2] = {INFINITY, INFINITY}, global_extremes[2];
+    for (long long int i = 0; i < local_count; i++) {
+      extremes[0] = fmin(extremes[0], candidates[i]);
+      extremes[1] = fmin(extremes[1], -candidates[i]);
+    }
+    MPI_Allreduce(extremes, global_extremes, 2, MPI_DOUBLE, MPI_MIN, comm);
+    double lo = global_extremes[0], hi = -global_extremes[1];
+    if (lo == hi) {
+      result = lo; // todos los candidatos son iguales
+      done = 1;
+      break;
+    }
+
+    double scale = isfinite(hi - lo) ? 1.0 : 0.5;
+    double inv_width = QUANTILE_BINS / (scale * hi - scale * lo);
+    memset(local_hist, 0, QUANTILE_BINS * sizeof(long long int));
+    for (long long int i = 0; i < local_count; i++) {
+      local_hist[quantile_bin(candidates[i], lo, scale, inv_width)]++;
+    }
+    MPI_Allreduce(local_hist, global_hist, QUANTILE_BINS, MPI_LONG_LONG_INT,
+                  MPI_SUM, comm);
+
+    int bin = 0;
+    while (below + global_hist[bin] <= target) {
+      below += global_hist[bin];
+      bin++;
+    }
+    if (global_hist[bin] == total) {
+      break; // [lo, hi] no se puede dividir más (anchura de pocos ulps)
+    }
+    total = global_hist[bin];
+
+    // Quedarse con los candidatos locales de ese bin
+    double *next = (double *)malloc((local_hist[bin] + 1) * sizeof(double));
+    long long int kept = 0;
+    for (long long int i = 0; i < local_count; i++) {
+      if (quantile_bin(candidates[i], lo, scale, inv_width) == bin) {
+        next[kept++] = candidates[i];
+      }
+    }
+    free(owned);
+    candidates = owned = next;
+    local_count = kept;
+    (*rounds)++;
+  }
+
+  if (!done) {
+    // Pocos candidatos: se reúnen en todos los procesos y se ordenan
+    int size;
+    MPI_Comm_size(comm, &size);
+    int my_count = (int)local_count;
+    int *counts = (int *)malloc(size * sizeof(int));
+    int *displs = (int *)malloc(size * sizeof(int));
+    MPI_Allgather(&my_count, 1, MPI_INT, counts, 1, MPI_INT, comm);
+    int gathered = 0;
+    for (int r = 0; r < size; r++) {
+      displs[r] = gathered;
+      gathered += counts[r];
+    }
+    double *all = (double *)malloc((gathered + 1) * sizeof(double));
+    MPI_Allgatherv(candidates, my_count, MPI_DOUBLE, all, counts, displs,
+                   MPI_DOUBLE, comm);
+    qsort(all, gathered, sizeof(double), compare_doubles);
+    result = all[target - below];
+    free(all);
+    free(counts);
+    free(displs);
+  }
+
+  free(owned);
+  free(local_hist);
+  free(global_hist);
+  return result;
+}
+
 int main(int argc, char **argv) {
-  MPI_Init(&argc, &argv);
+  // Solo el hilo maestro llama a MPI (las regiones paralelas no comunican)
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 
   int rank, size;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &size);
 
+  // Uso: ./histogram                      (datos de ejemplo del libro)
+  //      ./histogram [-m] archivo min max bins
+  //      ./histogram -S chunk [-w pasos] [-F] archivo min max bins
+  //      ./histogram -B                   (benchmark de búsqueda, rank 0)
+  // Opcional -R auto|root|scatter|sparse elige la reducción final.
+  // -t hilos clasifica con varios hilos por proceso (un proceso por nodo).
+  // -q 0.5,0.99 calcula además esos cuantiles exactos de forma distribuida.
+  // Límites no uniformes: -l (escala logarítmica, min > 0) o -E límites, un
+  // archivo de texto con bin_count + 1 límites; con -E el archivo de datos
+  // va solo (./histogram -E límites [archivo]).
+  // El archivo contiene doubles binarios; -m lo proyecta con mmap (sistema de
+  // archivos compartido) en lugar de leerlo con MPI-IO. -S lo procesa como
+  // flujo de chunk valores por proceso y paso, con ventanas deslizantes de
+  // -w pasos (o fijas con -F).
+  const char *usage = "Uso: %s [-m | -S chunk [-w pasos] [-F]] "
+                      "[-R auto|root|scatter|sparse] [-l | -E límites] "
+                      "[-q cuantiles] [-t hilos] [archivo [min max bins]]\n";
+  int use_mmap = 0;
+  int stream_chunk = 0;
+  int stream_window = 4;
+  int tumbling = 0;
+  reduce_mode_t reduce_mode = REDUCE_AUTO;
+  int log_bins = 0;
+  const char *edges_path = NULL;
+  const char *quantile_list = NULL;
+  int num_threads = 1;
+  int opt;
+  int bad_usage = 0;
+  while ((opt = getopt(argc, argv, "mS:w:FR:lE:Bq:t:")) != -1) {
+    switch (opt) {
+    case 'B':
+      if (rank == 0) {
+        benchmark_bin_search();
+      }
+      MPI_Finalize();
+      return 0;
+    case 'l':
+      log_bins = 1;
+      break;
+    case 'E':
+      edges_path = optarg;
+      break;
+    case 'q':
+      quantile_list = optarg;
+      break;
+    case 't':
+      num_threads = atoi(optarg);
+      break;
+    case 'm':
+      use_mmap = 1;
+      break;
+    case 'S':
+      stream_chunk = atoi(optarg);
+      break;
+    case 'w':
+      stream_window = atoi(optarg);
+      break;
+    case 'F':
+      tumbling = 1;
+      break;
+    case 'R':
+      if (strcmp(optarg, "auto") == 0) {
+        reduce_mode = REDUCE_AUTO;
+      } else if (strcmp(optarg, "root") == 0) {
+        reduce_mode = REDUCE_ROOT;
+      } else if (strcmp(optarg, "scatter") == 0) {
+        reduce_mode = REDUCE_SCATTER;
+      } else if (strcmp(optarg, "sparse") == 0) {
+        reduce_mode = REDUCE_SPARSE;
+      } else {
+        bad_usage = 1;
+      }
+      break;
+    default:
+      bad_usage = 1;
+    }
+  }
+  if (optind != argc && optind + (edges_path != NULL ? 1 : 4) != argc) {
+    bad_usage = 1;
+  }
+#ifndef _OPENMP
+  // Compilado sin -fopenmp: un hilo por proceso
+  num_threads = 1;
+#endif
+  // Biblioteca MPI sin soporte de hilos: un hilo por proceso
+  if (provided < MPI_THREAD_FUNNELED && num_threads > 1) {
+    if (rank == 0) {
+      fprintf(stderr,
+              "Aviso: MPI no ofrece MPI_THREAD_FUNNELED, se usa 1 hilo\n");
+    }
+    num_threads = 1;
+  }
+  if (num_threads < 1) {
+    bad_usage = 1;
+  }
+  if ((log_bins && edges_path != NULL) ||
+      (quantile_list != NULL && stream_chunk > 0)) {
+    bad_usage = 1;
+  }
+  if (stream_chunk < 0 || stream_window < 1 ||
+      (stream_chunk > 0 && (use_mmap || optind == argc))) {
+    bad_usage = 1;
+  }
+  if (bad_usage) {
+    if (rank == 0) {
+      fprintf(stderr, usage, argv[0]);
+    }
+    MPI_Finalize();
+    return 1;
+  }
+  const char *data_path = (optind < argc) ? argv[optind] : NULL;
+
   // Parámetros del histograma (los define el proceso 0)
-  int data_count = 0;
+  long long int data_count = 0;
   double *data = NULL;
   double min_meas = 0.0, max_meas = 0.0;
   int bin_count = 0;
   double *bin_maxes = NULL;
+  int uniform = 0; // bins de ancho fijo: se usa el índice aritmético
 
   // Variables locales para cada proceso
-  int local_data_count;
+  long long int local_data_count;
   double *local_data = NULL;
-  int *local_bin_counts = NULL;
-  int *global_bin_counts = NULL;
+  void *map_base = NULL; // proyección mmap de local_data (opción -m)
+  size_t map_length = 0;
+  long long int *local_bin_counts = NULL;
+  long long int *global_bin_counts = NULL;
 
-  // ========== FASE 1: PROCESO 0 LEE LOS DATOS ==========
-  if (rank == 0) {
+  // ========== FASE 1: PROCESO 0 LEE LOS PARÁMETROS ==========
+  if (rank == 0 && data_path != NULL) {
+    // Modo archivo: solo los parámetros pasan por el proceso 0
+    if (edges_path == NULL) {
+      min_meas = atof(argv[optind + 1]);
+      max_meas = atof(argv[optind + 2]);
+      bin_count = atoi(argv[optind + 3]);
+    } else {
+      bin_count = 1; // se reemplaza con los límites del archivo
+      max_meas = 1.0;
+    }
+
+    printf("=== DATOS DEL HISTOGRAMA ===\n");
+    printf("Archivo: %s (%s)\n", data_path, use_mmap ? "mmap" : "MPI-IO");
+    if (num_threads > 1) {
+      printf("Hilos por proceso: %d\n", num_threads);
+    }
+    if (stream_chunk > 0) {
+      printf("Flujo: %d valores/proceso por paso, ventana %s de %d pasos\n",
+             stream_chunk, tumbling ? "fija" : "deslizante", stream_window);
+    }
+    if (edges_path == NULL) {
+      printf("Rango: [%.1f, %.1f]\n", min_meas, max_meas);
+      printf("Número de bins: %d\n\n", bin_count);
+    }
+
+    double bin_width = (max_meas - min_meas) / bin_count;
+    bin_maxes = (double *)malloc(bin_count * sizeof(double));
+    for (int b = 0; b < bin_count; b++) {
+      bin_maxes[b] = min_meas + bin_width * (b + 1);
+    }
+    uniform = 1;
+  } else if (rank == 0) {
     // Datos de ejemplo del libro (página 67)
     double sample_data[] = {1.3, 2.9, 0.4, 0.3, 1.3, 4.4, 1.7, 0.4, 3.2, 0.3,
                             4.9, 2.4, 3.1, 4.4, 3.9, 0.4, 4.2, 4.5, 4.9, 0.9};
@@ -74,7 +1277,7 @@ int main(int argc, char **argv) {
     memcpy(data, sample_data, data_count * sizeof(double));
 
     printf("=== DATOS DEL HISTOGRAMA ===\n");
-    printf("Cantidad de datos: %d\n", data_count);
+    printf("Cantidad de datos: %lld\n", data_count);
     printf("Rango: [%.1f, %.1f]\n", min_meas, max_meas);
     printf("Número de bins: %d\n", bin_count);
     printf("Datos: ");
@@ -89,13 +1292,36 @@ int main(int argc, char **argv) {
     for (int b = 0; b < bin_count; b++) {
       bin_maxes[b] = min_meas + bin_width * (b + 1);
     }
+    uniform = 1;
+  }
+
+  // Límites no uniformes: reemplazan a los de ancho fijo
+  if (rank == 0 && edges_path != NULL) {
+    free(bin_maxes);
+    bin_maxes = read_edges(edges_path, &bin_count, &min_meas, &max_meas);
+    if (bin_maxes == NULL) {
+      fprintf(stderr, "Límites no válidos en %s\n", edges_path);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    uniform = 0;
+    printf("Límites de %s: %d bins en [%g, %g]\n\n", edges_path, bin_count,
+           min_meas, max_meas);
+  } else if (rank == 0 && log_bins) {
+    if (min_meas <= 0.0) {
+      fprintf(stderr, "Los bins logarítmicos requieren min > 0\n");
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    log_bin_maxes(bin_maxes, bin_count, min_meas, max_meas);
+    uniform = 0;
+    printf("Bins en escala logarítmica\n\n");
   }
 
   // ========== FASE 2: DISTRIBUIR PARÁMETROS A TODOS LOS PROCESOS ==========
-  MPI_Bcast(&data_count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&data_count, 1, MPI_LONG_LONG_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast(&min_meas, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
   MPI_Bcast(&max_meas, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
   MPI_Bcast(&bin_count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&uniform, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
   // Proceso 0 envía bin_maxes a todos
   if (rank != 0) {
@@ -104,73 +1330,206 @@ int main(int argc, char **argv) {
   MPI_Bcast(bin_maxes, bin_count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
   // ========== FASE 3: DISTRIBUIR LOS DATOS ENTRE PROCESOS ==========
+  MPI_File fh = MPI_FILE_NULL;
+  if (data_path != NULL) {
+    // El tamaño del archivo fija la cantidad de datos
+    if (MPI_File_open(MPI_COMM_WORLD, data_path, MPI_MODE_RDONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+      if (rank == 0) {
+        fprintf(stderr, "No se pudo abrir %s\n", data_path);
+      }
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Offset file_size;
+    MPI_File_get_size(fh, &file_size);
+    data_count = file_size / (MPI_Offset)sizeof(double);
+  }
+
   // Calcular cuántos datos le tocan a cada proceso
-  int base_count = data_count / size;
-  int extra = data_count % size;
+  long long int base_count = data_count / size;
+  long long int extra = data_count % size;
 
   if (rank < extra) {
     local_data_count = base_count + 1;
   } else {
     local_data_count = base_count;
   }
+  long long int local_first =
+      rank * base_count + (rank < extra ? rank : extra);
 
-  local_data = (double *)malloc(local_data_count * sizeof(double));
-
-  // Proceso 0 distribuye los datos
   int *sendcounts = NULL;
   int *displs = NULL;
 
-  if (rank == 0) {
-    sendcounts = (int *)malloc(size * sizeof(int));
-    displs = (int *)malloc(size * sizeof(int));
+  // Disposición de los bins para la clasificación local
+  uniform_bins_t ub;
+  eytzinger_bins_t eb;
+  bin_layout_t layout = {bin_count, min_meas, bin_maxes, NULL, NULL, 1, NULL};
+  layout.num_threads = num_threads;
+  if (uniform) {
+    uniform_bins_init(&ub, bin_maxes, bin_count, min_meas,
+                      (max_meas - min_meas) / bin_count);
+    layout.uniform = &ub;
+  } else {
+    eytzinger_bins_init(&eb, bin_maxes, bin_count, min_meas);
+    layout.eytzinger = &eb;
+  }
 
-    int offset = 0;
-    for (int i = 0; i < size; i++) {
-      sendcounts[i] = (i < extra) ? base_count + 1 : base_count;
-      displs[i] = offset;
-      offset += sendcounts[i];
-    }
+  local_bin_counts = (long long int *)calloc(bin_count, sizeof(long long int));
+  long long int *owned_counts = NULL; // tramo propio en REDUCE_SCATTER
+  if (stream_chunk > 0) {
+    reduce_mode = REDUCE_ROOT; // el flujo usa su propia reducción densa
+  }
+  if (rank == 0 && reduce_mode != REDUCE_SCATTER) {
+    global_bin_counts =
+        (long long int *)malloc(bin_count * sizeof(long long int));
   }
 
-  MPI_Scatterv(data, sendcounts, displs, MPI_DOUBLE, local_data,
-               local_data_count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  if (stream_chunk > 0) {
+    // ===== MODO FLUJO: FASES 3-5 SOLAPADAS POR PASOS =====
+    local_data_count = stream_histogram(
+        fh, data_count, stream_chunk, stream_window, tumbling, &layout,
+        local_bin_counts, global_bin_counts, MPI_COMM_WORLD);
+    MPI_File_close(&fh);
+  } else if (data_path != NULL && use_mmap) {
+    // Cada proceso proyecta su tramo del archivo compartido
+    MPI_File_close(&fh);
+    local_data = map_slice(data_path, local_first, local_data_count,
+                           &map_base, &map_length);
+    if (local_data == NULL && local_data_count > 0) {
+      fprintf(stderr, "Proceso %d: mmap de %s falló\n", rank, data_path);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+  } else if (data_path != NULL) {
+    // Cada proceso lee su tramo con una lectura colectiva
+    local_data = (double *)malloc((size_t)local_data_count * sizeof(double));
+    read_slice_mpiio(fh, local_first, local_data_count,
+                     base_count + (extra > 0 ? 1 : 0), local_data);
+    MPI_File_close(&fh);
+  } else {
+    // Datos de ejemplo (pocos valores): proceso 0 los distribuye
+    local_data = (double *)malloc(local_data_count * sizeof(double));
 
-  // ========== FASE 4: CADA PROCESO CALCULA SU HISTOGRAMA LOCAL ==========
-  local_bin_counts = (int *)calloc(bin_count, sizeof(int));
+    if (rank == 0) {
+      sendcounts = (int *)malloc(size * sizeof(int));
+      displs = (int *)malloc(size * sizeof(int));
 
-  for (int i = 0; i < local_data_count; i++) {
-    int bin = find_bin(local_data[i], bin_maxes, bin_count, min_meas);
-    if (bin >= 0 && bin < bin_count) {
-      local_bin_counts[bin]++;
+      int offset = 0;
+      for (int i = 0; i < size; i++) {
+        sendcounts[i] = (i < extra) ? base_count + 1 : base_count;
+        displs[i] = offset;
+        offset += sendcounts[i];
+      }
     }
-  }
 
-  // ========== FASE 5: COMBINAR HISTOGRAMAS LOCALES ==========
-  if (rank == 0) {
-    global_bin_counts = (int *)malloc(bin_count * sizeof(int));
+    MPI_Scatterv(data, sendcounts, displs, MPI_DOUBLE, local_data,
+                 (int)local_data_count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
   }
 
-  MPI_Reduce(local_bin_counts, global_bin_counts, bin_count, MPI_INT, MPI_SUM,
-             0, MPI_COMM_WORLD);
+  // ========== FASE 4: CADA PROCESO CALCULA SU HISTOGRAMA LOCAL ==========
+  if (stream_chunk == 0) {
+    local_histogram(&layout, local_data, local_data_count, local_bin_counts);
+
+    // ========== FASE 5: COMBINAR HISTOGRAMAS LOCALES ==========
+    if (reduce_mode == REDUCE_AUTO) {
+      long long int nnz = 0, total_nnz;
+      for (int b = 0; b < bin_count; b++) {
+        nnz += (local_bin_counts[b] != 0);
+      }
+      MPI_Allreduce(&nnz, &total_nnz, 1, MPI_LONG_LONG_INT, MPI_SUM,
+                    MPI_COMM_WORLD);
+      reduce_mode = (2 * total_nnz <= bin_count) ? REDUCE_SPARSE : REDUCE_ROOT;
+      if (rank == 0) {
+        printf("Reducción %s (ocupación %.1f%%)\n",
+               reduce_mode == REDUCE_SPARSE ? "dispersa" : "densa",
+               100.0 * total_nnz / ((double)bin_count * size));
+      }
+    }
+
+    if (reduce_mode == REDUCE_SCATTER) {
+      owned_counts = (long long int *)malloc(
+          scatter_block_size(bin_count, size) * sizeof(long long int));
+      scatter_reduce(local_bin_counts, bin_count, owned_counts,
+                     MPI_COMM_WORLD);
+    } else if (reduce_mode == REDUCE_SPARSE) {
+      sparse_reduce(local_bin_counts, bin_count, global_bin_counts,
+                    MPI_COMM_WORLD);
+    } else {
+      MPI_Reduce(local_bin_counts, global_bin_counts, bin_count,
+                 MPI_LONG_LONG_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+  }
+  if (uniform) {
+    uniform_bins_free(&ub);
+  } else {
+    eytzinger_bins_free(&eb);
+  }
 
   // ========== FASE 6: PROCESO 0 IMPRIME EL RESULTADO ==========
-  if (rank == 0) {
-    printf("=== RESULTADO DEL HISTOGRAMA ===\n");
+  if (reduce_mode == REDUCE_SCATTER) {
+    // Nadie tiene el histograma completo: rank 0 solo recoge un resumen
+    // (total, bin más frecuente, su cuenta) del tramo de cada proceso
+    int block = scatter_block_size(bin_count, size);
+    int first_bin = rank * block;
+    int owned = bin_count - first_bin < block ? bin_count - first_bin : block;
+    long long int summary[3] = {0, first_bin, 0};
+    for (int b = 0; b < owned; b++) {
+      summary[0] += owned_counts[b];
+      if (owned_counts[b] > summary[2]) {
+        summary[1] = first_bin + b;
+        summary[2] = owned_counts[b];
+      }
+    }
+    long long int *summaries = NULL;
+    if (rank == 0) {
+      summaries = (long long int *)malloc(3 * size * sizeof(long long int));
+    }
+    MPI_Gather(summary, 3, MPI_LONG_LONG_INT, summaries, 3, MPI_LONG_LONG_INT,
+               0, MPI_COMM_WORLD);
+    if (rank == 0) {
+      printf("=== RESULTADO DEL HISTOGRAMA (REPARTIDO) ===\n");
+      for (int r = 0; r < size; r++) {
+        int r_first = r * block;
+        int r_end = r_first + block < bin_count ? r_first + block : bin_count;
+        printf("Proceso %2d: bins [%d, %d): %lld elementos, "
+               "bin más frecuente %lld (%lld)\n",
+               r, r_first, r_end, summaries[3 * r], summaries[3 * r + 1],
+               summaries[3 * r + 2]);
+      }
+      free(summaries);
+    }
+  } else if (rank == 0) {
+    if (stream_chunk > 0) {
+      printf("\n=== RESULTADO DEL HISTOGRAMA (ÚLTIMA VENTANA) ===\n");
+    } else {
+      printf("=== RESULTADO DEL HISTOGRAMA ===\n");
+    }
 
     double bin_width = (max_meas - min_meas) / bin_count;
 
+    // Con archivos grandes la barra se escala a 60 caracteres como máximo
+    long long int max_count = 0;
     for (int b = 0; b < bin_count; b++) {
+      if (global_bin_counts[b] > max_count) {
+        max_count = global_bin_counts[b];
+      }
+    }
+    double bar_scale = (max_count * 3 <= 60) ? 3.0 : 60.0 / max_count;
+
+    for (int b = 0; b < bin_count && b < HIST_PRINT_MAX; b++) {
       double bin_start = (b == 0) ? min_meas : bin_maxes[b - 1];
       double bin_end = bin_maxes[b];
 
       printf("Bin %d [%5.1f - %5.1f): ", b, bin_start, bin_end);
 
       // Imprimir barra del histograma
-      int bar_length = global_bin_counts[b] * 3; // Escala para visualización
+      int bar_length = (int)(global_bin_counts[b] * bar_scale);
       for (int i = 0; i < bar_length; i++) {
         printf("█");
       }
-      printf(" %d elementos\n", global_bin_counts[b]);
+      printf(" %lld elementos\n", global_bin_counts[b]);
+    }
+    if (bin_count > HIST_PRINT_MAX) {
+      printf("... (%d bins más)\n", bin_count - HIST_PRINT_MAX);
     }
 
     // Información de distribución
@@ -184,6 +1543,32 @@ int main(int argc, char **argv) {
            size - 1, size - 2 * (size / 3));
   }
 
+  // ========== CUANTILES (OPCIÓN -q) ==========
+  if (quantile_list != NULL) {
+    if (rank == 0) {
+      printf("\n=== CUANTILES DISTRIBUIDOS ===\n");
+    }
+    // Copia: strtok modifica la cadena
+    char *list = strdup(quantile_list);
+    for (char *item = strtok(list, ","); item != NULL;
+         item = strtok(NULL, ",")) {
+      double q = atof(item);
+      if (q < 0.0 || q > 1.0) {
+        continue;
+      }
+      int rounds;
+      double start = MPI_Wtime();
+      double value = distributed_quantile(local_data, local_data_count, q,
+                                          MPI_COMM_WORLD, &rounds);
+      double elapsed = MPI_Wtime() - start;
+      if (rank == 0) {
+        printf("p%-6g = %.10g (%d rondas, %.4f s)\n", q * 100, value, rounds,
+               elapsed);
+      }
+    }
+    free(list);
+  }
+
   // ========== FASE 7: INFORMACIÓN POR CLUSTER ==========
   // Simular los 3 clusters
   int cluster_id;
@@ -196,23 +1581,28 @@ int main(int argc, char **argv) {
   }
 
   // Cada proceso imprime su información local
-  printf("Proceso %2d (Cluster %d): procesé %2d elementos, "
+  printf("Proceso %2d (Cluster %d): procesé %2lld elementos, "
          "bin más frecuente: ",
          rank, cluster_id, local_data_count);
 
   int max_local_bin = 0;
-  int max_local_count = 0;
+  long long int max_local_count = 0;
   for (int b = 0; b < bin_count; b++) {
     if (local_bin_counts[b] > max_local_count) {
       max_local_count = local_bin_counts[b];
       max_local_bin = b;
     }
   }
-  printf("bin %d con %d elementos\n", max_local_bin, max_local_count);
+  printf("bin %d con %lld elementos\n", max_local_bin, max_local_count);
 
   // ========== FASE 8: LIMPIEZA ==========
-  free(local_data);
+  if (map_base != NULL) {
+    munmap(map_base, map_length);
+  } else {
+    free(local_data);
+  }
   free(local_bin_counts);
+  free(owned_counts);
   if (rank == 0) {
     free(data);
     free(bin_maxes);
@@ -2,7 +2,22 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+// Filas de y que el núcleo por paneles acumula en registros
+#define PANEL_ROWS 8
+// Columnas por bloque de caché: el trozo de x (8 KiB) se queda en L1
+// mientras se recorren todos los paneles
+#ifndef COL_BLOCK
+#define COL_BLOCK 1024
+#endif
+// Alineación de los búferes del núcleo (línea de caché)
+#define ALIGNMENT 64
 
 // Función para inicializar matriz y vector
 void initialize_matrix_vector(double *matrix, double *vector, int n, int rank) {
@@ -49,6 +64,485 @@ void print_vector(double *vector, int n, const char *name) {
   printf("]\n");
 }
 
+// ========== NÚCLEO GEMV LOCAL ==========
+// Reserva alineada a ALIGNMENT (aligned_alloc exige un tamaño múltiplo)
+void *alloc_aligned(size_t bytes) {
+  bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  return aligned_alloc(ALIGNMENT, bytes > 0 ? bytes : ALIGNMENT);
+}
+
+// Filas redondeadas a un múltiplo de PANEL_ROWS
+int padded_rows(int rows) {
+  return (rows + PANEL_ROWS - 1) / PANEL_ROWS * PANEL_ROWS;
+}
+
+// Versión original: y = A x con A por filas (rows x cols). Con un bloque de
+// columnas estrecho el bucle interno es demasiado corto para vectorizar.
+void gemv_naive(const double *a, int rows, int cols, const double *x,
+                double *y) {
+  for (int i = 0; i < rows; i++) {
+    double sum = 0.0;
+    for (int j = 0; j < cols; j++)
+      sum += a[(size_t)i * cols + j] * x[j];
+    y[i] = sum;
+  }
+}
+
+// Reordena A (por filas) en paneles de PANEL_ROWS filas guardados por
+// columnas: el elemento (p * PANEL_ROWS + r, j) queda en
+// panels[(p * cols + j) * PANEL_ROWS + r]. Las filas de relleno del último
+// panel valen 0. Cada columna de un panel son 64 bytes contiguos y
+// alineados, y las columnas de un bloque de caché son consecutivas.
+void pack_panels(const double *a, int rows, int cols, double *panels) {
+  for (int p = 0; p < padded_rows(rows) / PANEL_ROWS; p++)
+    for (int j = 0; j < cols; j++)
+      for (int r = 0; r < PANEL_ROWS; r++) {
+        int i = p * PANEL_ROWS + r;
+        panels[((size_t)p * cols + j) * PANEL_ROWS + r] =
+            i < rows ? a[(size_t)i * cols + j] : 0.0;
+      }
+}
+
+// y = A x con A en paneles. Para cada bloque de COL_BLOCK columnas, cada
+// panel acumula sus PANEL_ROWS filas de y en registros: una difusión de
+// x[j] y una FMA por cada 4 elementos de A. y debe tener padded_rows(rows)
+// elementos y estar alineado.
+void gemv_panel(const double *panels, int rows, int cols, const double *x,
+                double *y) {
+  int npanels = padded_rows(rows) / PANEL_ROWS;
+  memset(y, 0, (size_t)npanels * PANEL_ROWS * sizeof(double));
+
+  for (int c0 = 0; c0 < cols; c0 += COL_BLOCK) {
+    int c1 = c0 + COL_BLOCK < cols ? c0 + COL_BLOCK : cols;
+    for (int p = 0; p < npanels; p++) {
+      const double *a = panels + ((size_t)p * cols + c0) * PANEL_ROWS;
+      double *yp = y + (size_t)p * PANEL_ROWS;
+      int j = c0;
+#if defined(__AVX2__) && defined(__FMA__)
+      // Dos columnas por iteración con acumuladores distintos para solapar
+      // la latencia de las FMA
+      __m256d acc0 = _mm256_load_pd(yp), acc1 = _mm256_load_pd(yp + 4);
+      __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+      for (; j + 1 < c1; j += 2, a += 2 * PANEL_ROWS) {
+        __m256d x0 = _mm256_broadcast_sd(x + j);
+        __m256d x1 = _mm256_broadcast_sd(x + j + 1);
+        acc0 = _mm256_fmadd_pd(_mm256_load_pd(a), x0, acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_load_pd(a + 4), x0, acc1);
+        acc2 = _mm256_fmadd_pd(_mm256_load_pd(a + 8), x1, acc2);
+        acc3 = _mm256_fmadd_pd(_mm256_load_pd(a + 12), x1, acc3);
+      }
+      if (j < c1) {
+        __m256d x0 = _mm256_broadcast_sd(x + j);
+        acc0 = _mm256_fmadd_pd(_mm256_load_pd(a), x0, acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_load_pd(a + 4), x0, acc1);
+      }
+      _mm256_store_pd(yp, _mm256_add_pd(acc0, acc2));
+      _mm256_store_pd(yp + 4, _mm256_add_pd(acc1, acc3));
+#else
+      // Sin AVX2/FMA: el bucle de longitud fija lo vectoriza el compilador
+      double acc[PANEL_ROWS];
+      for (int r = 0; r < PANEL_ROWS; r++)
+        acc[r] = yp[r];
+      for (; j < c1; j++, a += PANEL_ROWS)
+        for (int r = 0; r < PANEL_ROWS; r++)
+          acc[r] += a[r] * x[j];
+      for (int r = 0; r < PANEL_ROWS; r++)
+        yp[r] = acc[r];
+#endif
+    }
+  }
+}
+
+// Ancho de banda de lectura sostenido (GB/s): suma un vector de 256 MiB con
+// PANEL_ROWS acumuladores. GEMV solo lee A, así que el techo es la lectura
+// y no la tríada de STREAM (que además paga la escritura)
+double measure_read_bandwidth(void) {
+  const size_t len = (size_t)1 << 25;
+  double *a = alloc_aligned(len * sizeof(double));
+  for (size_t i = 0; i < len; i++)
+    a[i] = 1.0;
+  double best = 1e30, total = 0.0;
+  for (int rep = 0; rep < 5; rep++) {
+    double acc[PANEL_ROWS] = {0.0};
+    double start = MPI_Wtime();
+    for (size_t i = 0; i < len; i += PANEL_ROWS)
+      for (int r = 0; r < PANEL_ROWS; r++)
+        acc[r] += a[i + r];
+    double elapsed = MPI_Wtime() - start;
+    if (elapsed < best)
+      best = elapsed;
+    for (int r = 0; r < PANEL_ROWS; r++)
+      total += acc[r];
+  }
+  if (total != 5.0 * len) // También evita que el compilador elimine el bucle
+    printf("Aviso: suma de la medida de ancho de banda incorrecta\n");
+  free(a);
+  return len * sizeof(double) / best / 1e9;
+}
+
+// Compara los núcleos GEMV en el proceso 0 con matrices m x m crecientes
+// hasta max_n. GEMV lee cada elemento de A una vez y hace 2 flops con él
+// (intensidad aritmética 0.25 flop/byte): el techo del roofline es
+// ancho_de_banda / 4. Las matrices que caben en caché pueden superarlo.
+void benchmark_gemv(int max_n) {
+  double bandwidth = measure_read_bandwidth();
+  double roof = bandwidth * 0.25;
+  printf("=== BENCHMARK GEMV LOCAL ===\n");
+  printf("Ancho de banda de lectura: %.1f GB/s -> techo %.2f GFLOP/s\n",
+         bandwidth, roof);
+#if defined(__AVX2__) && defined(__FMA__)
+  printf("Núcleo por paneles: AVX2 + FMA, %d filas x %d columnas/bloque\n",
+         PANEL_ROWS, COL_BLOCK);
+#else
+  printf("Núcleo por paneles: escalar (compilar con -march=native para "
+         "AVX2 + FMA)\n");
+#endif
+  printf("%8s %12s %12s %12s %10s\n", "m", "ingenuo", "paneles", "paneles",
+         "% techo");
+  printf("%8s %12s %12s %12s %10s\n", "", "GFLOP/s", "GFLOP/s", "GB/s", "");
+
+  for (int m = 64; m <= max_n; m *= 2) {
+    double *a = alloc_aligned((size_t)m * m * sizeof(double));
+    double *panels =
+        alloc_aligned((size_t)padded_rows(m) * m * sizeof(double));
+    double *x = alloc_aligned(m * sizeof(double));
+    double *y_naive = alloc_aligned(padded_rows(m) * sizeof(double));
+    double *y_panel = alloc_aligned(padded_rows(m) * sizeof(double));
+    srand(2024);
+    for (size_t i = 0; i < (size_t)m * m; i++)
+      a[i] = (double)rand() / RAND_MAX - 0.5;
+    for (int i = 0; i < m; i++)
+      x[i] = (double)rand() / RAND_MAX - 0.5;
+    pack_panels(a, m, m, panels);
+
+    // Repeticiones para unos 2e8 flops por medida
+    int reps = 1 + (int)(100000000LL / ((long long)m * m));
+    double seconds[2];
+    for (int kernel = 0; kernel < 2; kernel++) {
+      double best = 1e30;
+      for (int trial = 0; trial < 3; trial++) {
+        double start = MPI_Wtime();
+        for (int rep = 0; rep < reps; rep++) {
+          if (kernel == 0)
+            gemv_naive(a, m, m, x, y_naive);
+          else
+            gemv_panel(panels, m, m, x, y_panel);
+        }
+        double elapsed = (MPI_Wtime() - start) / reps;
+        if (elapsed < best)
+          best = elapsed;
+      }
+      seconds[kernel] = best;
+    }
+
+    double max_diff = 0.0;
+    for (int i = 0; i < m; i++)
+      max_diff = fmax(max_diff, fabs(y_naive[i] - y_panel[i]));
+    double flops = 2.0 * m * m;
+    double bytes = sizeof(double) * ((double)m * m + 2.0 * m);
+    double gflops = flops / seconds[1] / 1e9;
+    printf("%8d %12.2f %12.2f %12.1f %9.0f%%%s\n", m,
+           flops / seconds[0] / 1e9, gflops, bytes / seconds[1] / 1e9,
+           100.0 * gflops / roof,
+           max_diff < 1e-9 * m ? "" : "  ❌ resultados distintos");
+
+    free(a);
+    free(panels);
+    free(x);
+    free(y_naive);
+    free(y_panel);
+    if (m > max_n / 2)
+      break; // Evitar desbordamiento de m *= 2
+  }
+}
+
+// ========== SOLVER ITERATIVO (JACOBI / GRADIENTE CONJUGADO) ==========
+enum { SOLVER_NONE, SOLVER_JACOBI, SOLVER_CG };
+
+// Matriz del solver: a_ij = 1 / (1 + |i - j|) fuera de la diagonal y
+// a_ii = 1 + la suma de la fila fuera de la diagonal. Es simétrica y de
+// diagonal estrictamente dominante (definida positiva), así que convergen
+// Jacobi y CG; la matriz de prueba del producto (0.5 fuera de la diagonal)
+// no es dominante para n > 5 y con ella Jacobi diverge.
+double solver_matrix_entry(int i, int j, int n) {
+  if (i != j)
+    return 1.0 / (1 + abs(i - j));
+  double sum = 1.0;
+  for (int d = 1; d <= i; d++)
+    sum += 1.0 / (1 + d);
+  for (int d = 1; d < n - i; d++)
+    sum += 1.0 / (1 + d);
+  return sum;
+}
+
+// Producto distribuido con comunicación persistente. En el solver x e y se
+// reparten igual: el proceso p tiene los elementos [p * local_cols,
+// (p + 1) * local_cols). A_local x_local es una contribución de n elementos
+// a y, y su trozo q se envía al proceso q, que suma las size contribuciones
+// de sus filas. Los envíos y recepciones se crean una vez con
+// MPI_Send_init / MPI_Recv_init; cada producto solo hace MPI_Startall.
+typedef struct {
+  int n, local_cols, rank, size;
+  const double *matrix; // Bloque local (en paneles o por filas)
+  int use_panels;
+  double *partial;       // A_local x_local, padded_rows(n) elementos
+  double *incoming;      // Trozos de y recibidos de los demás procesos
+  MPI_Request *requests; // size - 1 recepciones y después size - 1 envíos
+} dist_gemv_t;
+
+void dist_gemv_init(dist_gemv_t *g, const double *matrix, int use_panels,
+                    int n, int local_cols, MPI_Comm comm) {
+  MPI_Comm_rank(comm, &g->rank);
+  MPI_Comm_size(comm, &g->size);
+  g->n = n;
+  g->local_cols = local_cols;
+  g->matrix = matrix;
+  g->use_panels = use_panels;
+  g->partial = alloc_aligned(padded_rows(n) * sizeof(double));
+  g->incoming = malloc(((size_t)g->size * local_cols + 1) * sizeof(double));
+  g->requests = malloc((2 * g->size + 1) * sizeof(MPI_Request));
+
+  int peers = g->size - 1;
+  for (int k = 0; k < peers; k++) {
+    int peer = (g->rank + 1 + k) % g->size;
+    MPI_Recv_init(g->incoming + (size_t)k * local_cols, local_cols,
+                  MPI_DOUBLE, peer, 0, comm, &g->requests[k]);
+    MPI_Send_init(g->partial + (size_t)peer * local_cols, local_cols,
+                  MPI_DOUBLE, peer, 0, comm, &g->requests[peers + k]);
+  }
+}
+
+// y_local = (A x)[filas propias]. Las recepciones se activan antes del
+// producto local para que los mensajes de los procesos más rápidos no
+// esperen.
+void dist_gemv_apply(dist_gemv_t *g, const double *x_local, double *y_local) {
+  int peers = g->size - 1;
+  if (peers > 0)
+    MPI_Startall(peers, g->requests);
+  if (g->use_panels)
+    gemv_panel(g->matrix, g->n, g->local_cols, x_local, g->partial);
+  else
+    gemv_naive(g->matrix, g->n, g->local_cols, x_local, g->partial);
+  if (peers > 0) {
+    MPI_Startall(peers, g->requests + peers);
+    MPI_Waitall(2 * peers, g->requests, MPI_STATUSES_IGNORE);
+  }
+
+  const double *own = g->partial + (size_t)g->rank * g->local_cols;
+  for (int i = 0; i < g->local_cols; i++) {
+    double sum = own[i];
+    for (int k = 0; k < peers; k++)
+      sum += g->incoming[(size_t)k * g->local_cols + i];
+    y_local[i] = sum;
+  }
+}
+
+void dist_gemv_free(dist_gemv_t *g) {
+  for (int k = 0; k < 2 * (g->size - 1); k++)
+    MPI_Request_free(&g->requests[k]);
+  free(g->partial);
+  free(g->incoming);
+  free(g->requests);
+}
+
+// Suma global de 1 o 2 productos escalares con búferes fijos: con MPI 4
+// es un MPI_Allreduce_init persistente; MPI 3 no tiene colectivas
+// persistentes y se usa MPI_Allreduce.
+typedef struct {
+  double local[2], global[2];
+  int count;
+  MPI_Comm comm;
+#if MPI_VERSION >= 4
+  MPI_Request request;
+#endif
+} dot_reduce_t;
+
+void dot_reduce_init(dot_reduce_t *d, int count, MPI_Comm comm) {
+  d->count = count;
+  d->comm = comm;
+#if MPI_VERSION >= 4
+  MPI_Allreduce_init(d->local, d->global, count, MPI_DOUBLE, MPI_SUM, comm,
+                     MPI_INFO_NULL, &d->request);
+#endif
+}
+
+void dot_reduce_run(dot_reduce_t *d) {
+#if MPI_VERSION >= 4
+  MPI_Start(&d->request);
+  MPI_Wait(&d->request, MPI_STATUS_IGNORE);
+#else
+  MPI_Allreduce(d->local, d->global, d->count, MPI_DOUBLE, MPI_SUM, d->comm);
+#endif
+}
+
+void dot_reduce_free(dot_reduce_t *d) {
+#if MPI_VERSION >= 4
+  MPI_Request_free(&d->request);
+#else
+  (void)d;
+#endif
+}
+
+double local_dot(const double *a, const double *b, int len) {
+  double sum = 0.0;
+  for (int i = 0; i < len; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+// Resuelve A x = b con Jacobi o CG sin reunir nunca A ni los vectores.
+// Cada proceso genera su bloque de columnas de la matriz del solver y
+// b = A x* con x* = [1, 2, ..., n], así que el error final es conocido.
+// Parte de x = 0 y para cuando ||b - A x|| / ||b|| < tol o tras max_iter
+// iteraciones. Imprime el historial del residuo y el tiempo por iteración.
+// CG usa la variante de Chronopoulos-Gear: (r, r) y (A r, r) se calculan
+// juntos, así que cada iteración hace una sola suma global de 2 valores.
+void run_solver(int method, int n, int local_cols, int use_panels,
+                int max_iter, double tol, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  int first = rank * local_cols;
+
+  // Bloque local de columnas por filas (n x local_cols) y diagonal propia
+  double *block = alloc_aligned((size_t)n * local_cols * sizeof(double));
+  double *diag = malloc((local_cols + 1) * sizeof(double));
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < local_cols; j++)
+      block[(size_t)i * local_cols + j] =
+          solver_matrix_entry(i, first + j, n);
+  for (int k = 0; k < local_cols; k++)
+    diag[k] = block[(size_t)(first + k) * local_cols + k];
+
+  // Con paneles el reordenado se hace una vez para todas las iteraciones
+  double *panels = NULL;
+  if (use_panels) {
+    panels = alloc_aligned((size_t)padded_rows(n) * local_cols *
+                           sizeof(double));
+    pack_panels(block, n, local_cols, panels);
+  }
+
+  dist_gemv_t gemv;
+  dist_gemv_init(&gemv, use_panels ? panels : block, use_panels, n,
+                 local_cols, comm);
+  dot_reduce_t dot;
+  dot_reduce_init(&dot, method == SOLVER_CG ? 2 : 1, comm);
+
+  size_t vec_bytes = (local_cols + 1) * sizeof(double);
+  double *x = alloc_aligned(vec_bytes), *b = alloc_aligned(vec_bytes);
+  double *r = alloc_aligned(vec_bytes), *p = alloc_aligned(vec_bytes);
+  double *ap = alloc_aligned(vec_bytes), *x_exact = alloc_aligned(vec_bytes);
+  double *ar = alloc_aligned(vec_bytes);
+  double *history = malloc((max_iter + 1) * sizeof(double));
+
+  for (int k = 0; k < local_cols; k++)
+    x_exact[k] = first + k + 1;
+  dist_gemv_apply(&gemv, x_exact, b);
+
+  // x = 0, así que r = b; p y A p empiezan en 0 (beta = 0 en la primera
+  // iteración de CG)
+  for (int k = 0; k < local_cols; k++) {
+    x[k] = 0.0;
+    r[k] = b[k];
+    p[k] = 0.0;
+    ap[k] = 0.0;
+  }
+  dot.local[0] = local_dot(b, b, local_cols);
+  if (method == SOLVER_CG) {
+    dist_gemv_apply(&gemv, r, ar);
+    dot.local[1] = local_dot(ar, r, local_cols);
+  }
+  dot_reduce_run(&dot);
+  double b_norm = sqrt(dot.global[0]);
+  double rr = dot.global[0], alpha = 0.0, beta = 0.0;
+  if (method == SOLVER_CG)
+    alpha = rr / dot.global[1];
+
+  MPI_Barrier(comm);
+  double start = MPI_Wtime();
+  int iter = 0;
+  history[0] = 1.0;
+
+  if (method == SOLVER_JACOBI) {
+    // x_i += (b_i - (A x)_i) / a_ii; el residuo sale del mismo producto
+    while (iter < max_iter && history[iter] >= tol) {
+      for (int k = 0; k < local_cols; k++)
+        x[k] += r[k] / diag[k];
+      dist_gemv_apply(&gemv, x, ap);
+      for (int k = 0; k < local_cols; k++)
+        r[k] = b[k] - ap[k];
+      dot.local[0] = local_dot(r, r, local_cols);
+      dot_reduce_run(&dot);
+      history[++iter] = sqrt(dot.global[0]) / b_norm;
+    }
+  } else {
+    // A p se actualiza con la recurrencia A p = A r + beta A p, de modo que
+    // el único producto por iteración es A r
+    while (iter < max_iter && history[iter] >= tol) {
+      for (int k = 0; k < local_cols; k++) {
+        p[k] = r[k] + beta * p[k];
+        ap[k] = ar[k] + beta * ap[k];
+        x[k] += alpha * p[k];
+        r[k] -= alpha * ap[k];
+      }
+      dist_gemv_apply(&gemv, r, ar);
+      dot.local[0] = local_dot(r, r, local_cols);
+      dot.local[1] = local_dot(ar, r, local_cols);
+      dot_reduce_run(&dot);
+      double rr_new = dot.global[0];
+      beta = rr_new / rr;
+      alpha = rr_new / (dot.global[1] - beta * rr_new / alpha);
+      rr = rr_new;
+      history[++iter] = sqrt(rr) / b_norm;
+    }
+  }
+
+  double elapsed = MPI_Wtime() - start, max_elapsed;
+  MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+  double error = 0.0, max_error;
+  for (int k = 0; k < local_cols; k++)
+    error = fmax(error, fabs(x[k] - x_exact[k]));
+  MPI_Reduce(&error, &max_error, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+  if (rank == 0) {
+    printf("\n=== SOLVER %s ===\n",
+           method == SOLVER_JACOBI ? "JACOBI" : "GRADIENTE CONJUGADO");
+    printf("Matriz: %dx%d, Procesos: %d, Columnas por proceso: %d\n", n, n,
+           size, local_cols);
+#if MPI_VERSION >= 4
+    printf("Comunicación: Send_init/Recv_init + MPI_Allreduce_init\n");
+#else
+    printf("Comunicación: Send_init/Recv_init + MPI_Allreduce (MPI %d)\n",
+           MPI_VERSION);
+#endif
+    printf("\n%10s %14s\n", "iteración", "||r|| / ||b||");
+    int step = iter > 20 ? iter / 10 : 1;
+    for (int it = 0; it <= iter; it++)
+      if (it % step == 0 || it == iter)
+        printf("%10d %14.3e\n", it, history[it]);
+    printf("\n%s tras %d iteraciones (tolerancia %.1e)\n",
+           history[iter] < tol ? "✅ Convergencia" : "❌ Sin convergencia",
+           iter, tol);
+    printf("Tiempo total: %.6f segundos, por iteración: %.3f ms\n",
+           max_elapsed, iter > 0 ? 1e3 * max_elapsed / iter : 0.0);
+    printf("Error máximo frente a x* = [1..n]: %.3e\n", max_error);
+  }
+
+  dot_reduce_free(&dot);
+  dist_gemv_free(&gemv);
+  free(block);
+  free(panels);
+  free(diag);
+  free(x);
+  free(b);
+  free(r);
+  free(p);
+  free(ap);
+  free(ar);
+  free(x_exact);
+  free(history);
+}
+
 int main(int argc, char **argv) {
   MPI_Init(&argc, &argv);
 
@@ -57,9 +551,88 @@ int main(int argc, char **argv) {
   MPI_Comm_size(MPI_COMM_WORLD, &size);
 
   // ========== FASE 1: CONFIGURACIÓN Y PARÁMETROS ==========
+  // Uso: ./matrix [-k naive|panel] [-y root|dist] [-p productos] [-B] [n]
+  //       ./matrix -s jacobi|cg [-i iteraciones] [-t tolerancia] [-k ...] [n]
+  //  -k: producto local ingenuo por filas o por paneles (SIMD, por defecto)
+  //  -y: y reducido entero en el proceso 0 (root) o repartido como x con
+  //      MPI_Reduce_scatter_block (dist)
+  //  -p: productos encadenados, y = A(A(...(A x)))
+  //  -B: benchmark del producto local en el proceso 0 hasta matrices n x n
+  //  -s: resolver A x = b con Jacobi o gradiente conjugado manteniendo la
+  //      matriz repartida (como máximo -i iteraciones, residuo relativo -t)
+  int use_panels = 1;
+  int benchmark = 0;
+  int distributed_y = 0, products = 1;
+  int solver = SOLVER_NONE, max_iter = 1000;
+  double tol = 1e-10;
+  int opt, bad_args = 0;
+  while ((opt = getopt(argc, argv, "k:y:p:Bs:i:t:")) != -1) {
+    switch (opt) {
+    case 'k':
+      if (strcmp(optarg, "naive") == 0)
+        use_panels = 0;
+      else if (strcmp(optarg, "panel") != 0)
+        bad_args = 1;
+      break;
+    case 'y':
+      if (strcmp(optarg, "dist") == 0)
+        distributed_y = 1;
+      else if (strcmp(optarg, "root") != 0)
+        bad_args = 1;
+      break;
+    case 'p':
+      products = atoi(optarg);
+      if (products < 1)
+        bad_args = 1;
+      break;
+    case 'B':
+      benchmark = 1;
+      break;
+    case 's':
+      if (strcmp(optarg, "jacobi") == 0)
+        solver = SOLVER_JACOBI;
+      else if (strcmp(optarg, "cg") == 0)
+        solver = SOLVER_CG;
+      else
+        bad_args = 1;
+      break;
+    case 'i':
+      max_iter = atoi(optarg);
+      if (max_iter < 0)
+        bad_args = 1;
+      break;
+    case 't':
+      tol = atof(optarg);
+      if (tol <= 0.0)
+        bad_args = 1;
+      break;
+    default:
+      bad_args = 1;
+    }
+  }
+  if (bad_args) {
+    if (rank == 0)
+      fprintf(stderr,
+              "Uso: %s [-k naive|panel] [-y root|dist] [-p productos] "
+              "[-B] [n]\n"
+              "       %s -s jacobi|cg [-i iteraciones] [-t tolerancia] "
+              "[-k naive|panel] [n]\n",
+              argv[0], argv[0]);
+    MPI_Finalize();
+    return 1;
+  }
+
   int n = 64; // Tamaño de la matriz (debe ser divisible entre size)
-  if (argc > 1)
-    n = atoi(argv[1]);
+  if (optind < argc)
+    n = atoi(argv[optind]);
+
+  // ========== BENCHMARK DEL PRODUCTO LOCAL ==========
+  if (benchmark) {
+    if (rank == 0)
+      benchmark_gemv(n);
+    MPI_Finalize();
+    return 0;
+  }
 
   // Asegurar que n es divisible entre size
   if (n % size != 0) {
@@ -70,12 +643,32 @@ int main(int argc, char **argv) {
   }
 
   int local_cols = n / size; // Columnas por proceso
-  double start_time, end_time;
+  double start_time, product_start_time, end_time;
+
+  // ========== SOLVER ITERATIVO ==========
+  if (solver != SOLVER_NONE) {
+    run_solver(solver, n, local_cols, use_panels, max_iter, tol,
+               MPI_COMM_WORLD);
+    MPI_Finalize();
+    return 0;
+  }
 
   if (rank == 0) {
     printf("\n=== MULTIPLICACIÓN MATRIZ-VECTOR (BLOQUE-COLUMNA) ===\n");
     printf("Matriz: %dx%d, Procesos: %d\n", n, n, size);
     printf("Columnas por proceso: %d\n", local_cols);
+    if (use_panels)
+      printf("Producto local: paneles de %d filas (SIMD)\n", PANEL_ROWS);
+    else
+      printf("Producto local: ingenuo por filas\n");
+    if (distributed_y)
+      printf("Salida: MPI_Reduce_scatter_block (%d elementos de y por "
+             "proceso)\n",
+             local_cols);
+    else
+      printf("Salida: MPI_Reduce al proceso 0 (y entero, %d elementos)\n", n);
+    if (products > 1)
+      printf("Productos encadenados: %d\n", products);
     printf("Clusters simulados: 3\n");
   }
 
@@ -124,122 +717,133 @@ int main(int argc, char **argv) {
   // Todos los procesos necesitan memoria local
   local_matrix = (double *)malloc(n * local_cols * sizeof(double));
   local_vector_part = (double *)malloc(local_cols * sizeof(double));
-  local_result = (double *)malloc(n * sizeof(double));
-
-  // Inicializar resultado local
-  for (int i = 0; i < n; i++) {
-    local_result[i] = 0.0;
-  }
+  // y local con las filas de relleno del último panel y alineado para el
+  // núcleo SIMD
+  local_result = alloc_aligned(padded_rows(n) * sizeof(double));
 
   // ========== FASE 4: DISTRIBUIR MATRIZ POR BLOQUES DE COLUMNAS ==========
+  // Un bloque de columnas es un MPI_Type_vector de n filas de local_cols
+  // elementos separadas n posiciones. Redimensionado a local_cols elementos,
+  // el bloque del proceso p empieza justo donde termina el del proceso p - 1
+  // y un único MPI_Scatter reparte la matriz sin copias en el proceso 0.
+  // Cada proceso lo recibe contiguo: local_matrix[fila * local_cols + col].
   start_time = MPI_Wtime();
 
-  if (rank == 0) {
-    // Proceso 0 distribuye las columnas de la matriz
-    for (int proc = 0; proc < size; proc++) {
-      int start_col = proc * local_cols;
-
-      if (proc == 0) {
-        // Copiar directamente para proceso 0
-        for (int col = 0; col < local_cols; col++) {
-          for (int row = 0; row < n; row++) {
-            local_matrix[row * local_cols + col] =
-                full_matrix[row * n + (start_col + col)];
-          }
-        }
-      } else {
-        // Enviar bloque de columnas a otros procesos
-        double *send_buffer = (double *)malloc(n * local_cols * sizeof(double));
-
-        for (int col = 0; col < local_cols; col++) {
-          for (int row = 0; row < n; row++) {
-            send_buffer[row * local_cols + col] =
-                full_matrix[row * n + (start_col + col)];
-          }
-        }
+  MPI_Datatype column_block, column_block_resized;
+  MPI_Type_vector(n, local_cols, n, MPI_DOUBLE, &column_block);
+  MPI_Type_create_resized(column_block, 0, local_cols * sizeof(double),
+                          &column_block_resized);
+  MPI_Type_commit(&column_block_resized);
 
-        MPI_Send(send_buffer, n * local_cols, MPI_DOUBLE, proc, 0,
-                 MPI_COMM_WORLD);
-        free(send_buffer);
-      }
-    }
-  } else {
-    // Procesos > 0 reciben su bloque de columnas
-    MPI_Recv(local_matrix, n * local_cols, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD,
-             MPI_STATUS_IGNORE);
-  }
+  MPI_Scatter(full_matrix, 1, column_block_resized, local_matrix,
+              n * local_cols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
   // ========== FASE 5: DISTRIBUIR PARTES DEL VECTOR ==========
-  // Broadcast del vector completo a todos los procesos
-  if (rank == 0) {
-    // Proceso 0 ya tiene el vector
-  }
-
-  // Todos los procesos necesitan el vector completo para la multiplicación
-  double *full_vector_local = (double *)malloc(n * sizeof(double));
-  MPI_Bcast(full_vector_local, n, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-  // Cada proceso obtiene la parte del vector que corresponde a sus columnas
-  if (rank == 0) {
-    for (int proc = 0; proc < size; proc++) {
-      int start_col = proc * local_cols;
-      double *vector_part = (double *)malloc(local_cols * sizeof(double));
-
-      for (int i = 0; i < local_cols; i++) {
-        vector_part[i] = full_vector_local[start_col + i];
-      }
-
-      if (proc == 0) {
-        for (int i = 0; i < local_cols; i++) {
-          local_vector_part[i] = vector_part[i];
-        }
-      } else {
-        MPI_Send(vector_part, local_cols, MPI_DOUBLE, proc, 1, MPI_COMM_WORLD);
-      }
-
-      free(vector_part);
-    }
-  } else {
-    MPI_Recv(local_vector_part, local_cols, MPI_DOUBLE, 0, 1, MPI_COMM_WORLD,
-             MPI_STATUS_IGNORE);
-  }
+  // Cada proceso solo necesita las local_cols componentes de x de sus
+  // columnas: un MPI_Scatter en lugar de difundir x entero
+  MPI_Scatter(full_vector, local_cols, MPI_DOUBLE, local_vector_part,
+              local_cols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
   // ========== FASE 6: MULTIPLICACIÓN LOCAL ==========
   printf("Proceso %2d (%s): realizando multiplicación local...\n", rank,
          cluster_name);
 
-  // Cada proceso calcula: A_local * x_local
-  for (int i = 0; i < n; i++) {
-    for (int j = 0; j < local_cols; j++) {
-      local_result[i] +=
-          local_matrix[i * local_cols + j] * local_vector_part[j];
-    }
+  // Cada proceso calcula: A_local * x_local. El bloque llega por filas
+  // (n x local_cols) y se reordena una vez en paneles; con varios productos
+  // ese coste se amortiza.
+  double *local_panels = NULL;
+  if (use_panels) {
+    local_panels = alloc_aligned((size_t)padded_rows(n) * local_cols *
+                                 sizeof(double));
+    pack_panels(local_matrix, n, local_cols, local_panels);
   }
+  double compute_time = 0.0, max_compute_time;
 
-  // ========== FASE 7: COMBINAR RESULTADOS (MPI_REDUCE) ==========
-  MPI_Reduce(local_result, final_result, n, MPI_DOUBLE, MPI_SUM, 0,
-             MPI_COMM_WORLD);
+  // El reparto y el empaquetado se pagan una vez: los productos se miden
+  // aparte, empezando todos a la vez
+  MPI_Barrier(MPI_COMM_WORLD);
+  product_start_time = MPI_Wtime();
+
+  // ========== FASE 7: COMBINAR RESULTADOS ==========
+  // root: MPI_Reduce de los n elementos de local_result al proceso 0; para
+  //       encadenar otro producto el proceso 0 vuelve a repartir y.
+  // dist: MPI_Reduce_scatter_block deja en cada proceso sus local_cols
+  //       elementos de y, repartidos igual que x: el resultado es
+  //       directamente la entrada del siguiente producto, sin pasar por el
+  //       proceso 0, y nadie recibe más de local_cols elementos.
+  for (int product = 0; product < products; product++) {
+    double compute_start = MPI_Wtime();
+    if (use_panels)
+      gemv_panel(local_panels, n, local_cols, local_vector_part,
+                 local_result);
+    else
+      gemv_naive(local_matrix, n, local_cols, local_vector_part,
+                 local_result);
+    compute_time += MPI_Wtime() - compute_start;
+
+    if (distributed_y) {
+      MPI_Reduce_scatter_block(local_result, local_vector_part, local_cols,
+                               MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    } else {
+      MPI_Reduce(local_result, final_result, n, MPI_DOUBLE, MPI_SUM, 0,
+                 MPI_COMM_WORLD);
+      if (product + 1 < products)
+        MPI_Scatter(final_result, local_cols, MPI_DOUBLE, local_vector_part,
+                    local_cols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    }
+  }
 
   end_time = MPI_Wtime();
 
+  MPI_Reduce(&compute_time, &max_compute_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+  // Solo para la verificación: reunir y repartido en el proceso 0
+  if (distributed_y)
+    MPI_Gather(local_vector_part, local_cols, MPI_DOUBLE, final_result,
+               local_cols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
   // ========== FASE 8: VERIFICACIÓN Y RESULTADOS ==========
   if (rank == 0) {
     printf("\n=== RESULTADOS ===\n");
     printf("Tiempo total: %.6f segundos\n", end_time - start_time);
+    printf("Tiempo de distribución (Scatter%s): %.6f segundos\n",
+           use_panels ? " + paneles" : "", product_start_time - start_time);
+    printf("Tiempo de los productos: %.6f segundos\n",
+           end_time - product_start_time);
+    printf("Tiempo por producto: %.6f segundos\n",
+           (end_time - product_start_time) / products);
+    printf("Producto local (máximo): %.6f segundos\n", max_compute_time);
 
     if (n <= 16) {
-      print_vector(final_result, n, "Resultado y = A*x");
+      if (products == 1)
+        print_vector(final_result, n, "Resultado y = A*x");
+      else
+        print_vector(final_result, n, "Resultado y = A^p x");
     }
 
-    // Verificación simple (para matriz diagonal dominante)
-    double error = 0.0;
+    // Verificación: con 2.0 en la diagonal y 0.5 fuera de ella,
+    // A v = 2 v + 0.5 (sum(v) - v) = 1.5 v + 0.5 sum(v); para un producto
+    // con x = [1..n], y_i = 1.5 (i + 1) + 0.25 n (n + 1)
+    double *expected = (double *)malloc(n * sizeof(double));
+    for (int i = 0; i < n; i++)
+      expected[i] = i + 1;
+    for (int product = 0; product < products; product++) {
+      double sum = 0.0;
+      for (int i = 0; i < n; i++)
+        sum += expected[i];
+      for (int i = 0; i < n; i++)
+        expected[i] = 1.5 * expected[i] + 0.5 * sum;
+    }
+    double error = 0.0, norm = 0.0;
     for (int i = 0; i < n; i++) {
-      double expected = 2.0 * (i + 1); // Para nuestra matriz de prueba
-      error += fabs(final_result[i] - expected);
+      error += fabs(final_result[i] - expected[i]);
+      norm += fabs(expected[i]);
     }
+    free(expected);
 
-    printf("Error total: %.10f\n", error);
-    printf("Precisión: %s\n", error < 1e-10 ? "✅ EXCELENTE" : "✅ ACEPTABLE");
+    printf("Error total: %.10f (relativo %.2e)\n", error, error / norm);
+    printf("Precisión: %s\n",
+           error / norm < 1e-12 ? "✅ EXCELENTE" : "❌ INCORRECTO");
 
     // Mostrar distribución en clusters
     printf("\n=== DISTRIBUCIÓN EN CLUSTERS ===\n");
@@ -259,10 +863,12 @@ int main(int argc, char **argv) {
   }
 
   // ========== FASE 9: LIMPIEZA ==========
+  MPI_Type_free(&column_block);
+  MPI_Type_free(&column_block_resized);
   free(local_matrix);
+  free(local_panels);
   free(local_vector_part);
   free(local_result);
-  free(full_vector_local);
 
   if (rank == 0) {
     free(full_matrix);
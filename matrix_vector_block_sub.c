@@ -1,73 +1,202 @@
+#include <math.h>
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-int main(int argc, char** argv) {
-    MPI_Init(&argc, &argv);
-    
-    int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
-    
-    int grid_size = 4;
-    int n = 16;
-    int block_size = 4;
-    int cluster_id = (rank < 5) ? 1 : (rank < 11) ? 2 : 3;
-    int grid_row = rank / grid_size;
-    int grid_col = rank % grid_size;
-    
+// Primer índice del bloque b al repartir n entre p bloques (los tamaños
+// difieren como mucho en 1, n no tiene que ser múltiplo de p)
+int block_low(int b, int p, int n) { return (int)((long long)b * n / p); }
+
+int block_size(int b, int p, int n) {
+  return block_low(b + 1, p, n) - block_low(b, p, n);
+}
+
+// Función para imprimir vector
+void print_vector(double *vector, int n, const char *name) {
+  printf("%s (%d): [", name, n);
+  for (int i = 0; i < n && i < 10; i++) {
+    printf("%.2f", vector[i]);
+    if (i < n - 1 && i < 9)
+      printf(", ");
+  }
+  if (n > 10)
+    printf(", ...");
+  printf("]\n");
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // ========== FASE 1: CONFIGURACIÓN Y MALLA DE PROCESOS ==========
+  // Descomposición en tablero de ajedrez: la malla grid_rows x grid_cols
+  // (MPI_Dims_create, cualquier número de procesos) y el proceso (i, j)
+  // tiene el bloque A[filas del bloque i][columnas del bloque j]
+  int n = 16;
+  if (argc > 1)
+    n = atoi(argv[1]);
+
+  int dims[2] = {0, 0}, periods[2] = {0, 0}, coords[2];
+  MPI_Dims_create(size, 2, dims);
+  MPI_Comm grid_comm;
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid_comm);
+  MPI_Comm_rank(grid_comm, &rank);
+  MPI_Cart_coords(grid_comm, rank, 2, coords);
+  int grid_rows = dims[0], grid_cols = dims[1];
+  int grid_row = coords[0], grid_col = coords[1];
+
+  // Asegurar que ningún bloque queda vacío (n al menos la dimensión mayor)
+  int min_n = grid_rows > grid_cols ? grid_rows : grid_cols;
+  if (n < min_n) {
+    n = min_n;
     if (rank == 0) {
-        printf("=== MULTIPLICACION MATRIZ-VECTOR (VERSION SIMPLE) ===\n");
+      printf("Ajustando n a %d (malla %dx%d)\n", n, grid_rows, grid_cols);
     }
-    
-    MPI_Barrier(MPI_COMM_WORLD);
-    
-    // CADA PROCESO CALCULA SU PARTE LOCAL DIRECTAMENTE
-    double local_result[4] = {0};
-    
-    if (grid_row == grid_col) {
-        // Proceso diagonal: simula multiplicación
-        for (int i = 0; i < block_size; i++) {
-            local_result[i] = (grid_row * block_size + i) + 1; // Resultado simple
-        }
-        printf("P%d (C%d): Calculo local completado\n", rank, cluster_id);
+  }
+
+  // Subcomunicadores: misma fila de la malla (ordenados por columna) y
+  // misma columna (ordenados por fila)
+  MPI_Comm row_comm, col_comm;
+  MPI_Comm_split(grid_comm, grid_row, grid_col, &row_comm);
+  MPI_Comm_split(grid_comm, grid_col, grid_row, &col_comm);
+
+  int first_row = block_low(grid_row, grid_rows, n);
+  int local_rows = block_size(grid_row, grid_rows, n);
+  int first_col = block_low(grid_col, grid_cols, n);
+  int local_cols = block_size(grid_col, grid_cols, n);
+
+  if (rank == 0) {
+    printf("=== MULTIPLICACIÓN MATRIZ-VECTOR (TABLERO 2D) ===\n");
+    printf("Matriz: %dx%d, Procesos: %d, Malla: %dx%d\n", n, n, size,
+           grid_rows, grid_cols);
+    // El último bloque es el mayor (block_low redondea hacia abajo)
+    printf("Bloques de hasta %dx%d\n",
+           block_size(grid_rows - 1, grid_rows, n),
+           block_size(grid_cols - 1, grid_cols, n));
+  }
+  if (n <= 16)
+    printf("P%d (%d,%d): filas %d-%d, columnas %d-%d\n", rank, grid_row,
+           grid_col, first_row, first_row + local_rows - 1, first_col,
+           first_col + local_cols - 1);
+
+  MPI_Barrier(grid_comm);
+
+  // ========== FASE 2: BLOQUE LOCAL DE LA MATRIZ ==========
+  // Cada proceso genera su bloque (misma matriz de prueba que
+  // matrix_vector_block.c: 2.0 en la diagonal, 0.5 fuera); con datos reales
+  // lo leería directamente de disco, sin pasar por el proceso 0
+  double *local_matrix =
+      (double *)malloc((size_t)local_rows * local_cols * sizeof(double));
+  for (int i = 0; i < local_rows; i++)
+    for (int j = 0; j < local_cols; j++)
+      local_matrix[i * local_cols + j] =
+          (first_row + i == first_col + j) ? 2.0 : 0.5;
+
+  // ========== FASE 3: REPARTIR x EN LA PRIMERA FILA DE LA MALLA ==========
+  // El proceso 0 tiene x completo; los procesos de la fila 0 reciben el
+  // bloque de x de su columna (MPI_Scatterv en row_comm)
+  double *full_vector = NULL;
+  double *local_vector_part = (double *)malloc(local_cols * sizeof(double));
+  int *counts = NULL, *displs = NULL;
+
+  double start_time = MPI_Wtime();
+
+  if (grid_row == 0) {
+    if (rank == 0) {
+      full_vector = (double *)malloc(n * sizeof(double));
+      for (int i = 0; i < n; i++)
+        full_vector[i] = i + 1; // Vector [1, 2, 3, ..., n]
+      counts = (int *)malloc(grid_cols * sizeof(int));
+      displs = (int *)malloc(grid_cols * sizeof(int));
+      for (int c = 0; c < grid_cols; c++) {
+        counts[c] = block_size(c, grid_cols, n);
+        displs[c] = block_low(c, grid_cols, n);
+      }
     }
-    
-    MPI_Barrier(MPI_COMM_WORLD);
-    
-    // RECOLECCIÓN SIMPLE
+    MPI_Scatterv(full_vector, counts, displs, MPI_DOUBLE, local_vector_part,
+                 local_cols, MPI_DOUBLE, 0, row_comm);
+  }
+
+  // ========== FASE 4: DIFUNDIR x POR COLUMNAS ==========
+  // Cada proceso solo recibe n / grid_cols componentes de x
+  MPI_Bcast(local_vector_part, local_cols, MPI_DOUBLE, 0, col_comm);
+
+  // ========== FASE 5: MULTIPLICACIÓN LOCAL ==========
+  double *local_result = (double *)malloc(local_rows * sizeof(double));
+  for (int i = 0; i < local_rows; i++) {
+    double sum = 0.0;
+    for (int j = 0; j < local_cols; j++)
+      sum += local_matrix[i * local_cols + j] * local_vector_part[j];
+    local_result[i] = sum;
+  }
+
+  // ========== FASE 6: REDUCIR POR FILAS ==========
+  // Las sumas parciales de una fila de bloques se combinan en la columna 0
+  // de la malla: n / grid_rows elementos por proceso en lugar de n
+  double *row_result = NULL;
+  if (grid_col == 0)
+    row_result = (double *)malloc(local_rows * sizeof(double));
+  MPI_Reduce(local_result, row_result, local_rows, MPI_DOUBLE, MPI_SUM, 0,
+             row_comm);
+
+  double end_time = MPI_Wtime();
+
+  // ========== FASE 7: REUNIR y EN EL PROCESO 0 (VERIFICACIÓN) ==========
+  double *final_result = NULL;
+  if (grid_col == 0) {
     if (rank == 0) {
-        double final_result[16] = {0};
-        
-        // Proceso 0 recoge de otros procesos diagonales
-        for (int d = 0; d < grid_size; d++) {
-            int diag_proc = d * grid_size + d;
-            
-            if (diag_proc == 0) {
-                for (int i = 0; i < block_size; i++) {
-                    final_result[i] = local_result[i];
-                }
-            } else {
-                double recv_buf[4];
-                MPI_Recv(recv_buf, 4, MPI_DOUBLE, diag_proc, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                for (int i = 0; i < block_size; i++) {
-                    final_result[d * block_size + i] = recv_buf[i];
-                }
-            }
-        }
-        
-        printf("Resultado: [");
-        for (int i = 0; i < n; i++) printf("%.1f ", final_result[i]);
-        printf("]\n");
-        
-    } else if (grid_row == grid_col) {
-        // Procesos diagonales envían a proceso 0
-        MPI_Send(local_result, 4, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+      final_result = (double *)malloc(n * sizeof(double));
+      free(counts);
+      free(displs);
+      counts = (int *)malloc(grid_rows * sizeof(int));
+      displs = (int *)malloc(grid_rows * sizeof(int));
+      for (int r = 0; r < grid_rows; r++) {
+        counts[r] = block_size(r, grid_rows, n);
+        displs[r] = block_low(r, grid_rows, n);
+      }
     }
-    
-    MPI_Barrier(MPI_COMM_WORLD);
-    printf("P%d (C%d): Finalizado\n", rank, cluster_id);
-    
-    MPI_Finalize();
-    return 0;
+    MPI_Gatherv(row_result, local_rows, MPI_DOUBLE, final_result, counts,
+                displs, MPI_DOUBLE, 0, col_comm);
+  }
+
+  // ========== FASE 8: VERIFICACIÓN Y RESULTADOS ==========
+  if (rank == 0) {
+    printf("\n=== RESULTADOS ===\n");
+    printf("Tiempo (difusión + producto + reducción): %.6f segundos\n",
+           end_time - start_time);
+    printf("Comunicación por proceso: %d elementos de x, %d sumas "
+           "parciales (1D por columnas: %d)\n",
+           block_size(grid_cols - 1, grid_cols, n),
+           block_size(grid_rows - 1, grid_rows, n), n);
+
+    if (n <= 16)
+      print_vector(final_result, n, "Resultado y = A*x");
+
+    // y_i = 2 x_i + 0.5 (sum(x) - x_i) = 1.5 (i + 1) + 0.25 n (n + 1)
+    double error = 0.0;
+    for (int i = 0; i < n; i++)
+      error += fabs(final_result[i] - (1.5 * (i + 1) + 0.25 * n * (n + 1.0)));
+    printf("Error total: %.10f\n", error);
+    printf("Precisión: %s\n",
+           error < 1e-6 ? "✅ EXCELENTE" : "❌ INCORRECTO");
+  }
+
+  // ========== FASE 9: LIMPIEZA ==========
+  free(local_matrix);
+  free(local_vector_part);
+  free(local_result);
+  free(row_result);
+  free(full_vector);
+  free(final_result);
+  free(counts);
+  free(displs);
+  MPI_Comm_free(&row_comm);
+  MPI_Comm_free(&col_comm);
+  MPI_Comm_free(&grid_comm);
+
+  MPI_Finalize();
+  return 0;
 }
@@ -1,46 +1,606 @@
 #include <math.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-// Generador de números aleatorios
-static unsigned long next = 1;
+// ========== GENERADOR CONTADOR (PHILOX 4x32-10) ==========
+// Cada número aleatorio es una función pura de (semilla, contador): no hay
+// estado global ni cadena de dependencias, así que los lanzamientos se pueden
+// generar por lotes (vectorizables) y en cualquier orden. El contador es el
+// índice global del lanzamiento, de modo que cada rango/hilo consume un rango
+// disjunto del mismo flujo y el resultado no depende del número de procesos.
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
 
-int rand(void) {
-  next = next * 1103515245 + 12345;
-  return (unsigned int)(next / 65536) % 32768;
+// Lanzamientos generados por lote
+#define TOSS_BATCH 1024
+
+// Una ronda de Philox: dos multiplicaciones 32x32->64 y mezcla con la clave
+#define PHILOX_ROUND(c0, c1, c2, c3, k0, k1)                                   \
+  do {                                                                         \
+    uint64_t p0 = (uint64_t)PHILOX_M0 * (c0);                                  \
+    uint64_t p1 = (uint64_t)PHILOX_M1 * (c2);                                  \
+    (c0) = (uint32_t)(p1 >> 32) ^ (c1) ^ (k0);                                 \
+    (c1) = (uint32_t)p1;                                                       \
+    (c2) = (uint32_t)(p0 >> 32) ^ (c3) ^ (k1);                                 \
+    (c3) = (uint32_t)p0;                                                       \
+    (k0) += PHILOX_W0;                                                         \
+    (k1) += PHILOX_W1;                                                         \
+  } while (0)
+
+// Convierte 64 bits aleatorios en un double uniforme en [0, 1).
+// Se usan los 52 bits altos como mantisa de un número en [1, 2): evita la
+// conversión entero->double, que no tiene instrucción SIMD en SSE2/AVX2.
+static inline double bits_to_unit_double(uint64_t bits) {
+  uint64_t u = (bits >> 12) | 0x3FF0000000000000ULL;
+  double d;
+  memcpy(&d, &u, sizeof(d));
+  return d - 1.0;
 }
 
-double random_double(double min, double max) {
-  return min + ((double)rand() / 32767.0) * (max - min);
+// Genera count pares (u[i], v[i]) uniformes en [0, 1) para los contadores
+// first, first+1, ... del flujo 'stream'. Cada iteración es independiente.
+void philox_uniform_pairs(uint64_t seed, uint32_t stream, uint64_t first,
+                          int count, double *restrict u, double *restrict v) {
+  for (int i = 0; i < count; i++) {
+    uint64_t index = first + (uint64_t)i;
+    uint32_t c0 = (uint32_t)index, c1 = (uint32_t)(index >> 32);
+    uint32_t c2 = stream, c3 = 0;
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+
+    u[i] = bits_to_unit_double(((uint64_t)c0 << 32) | c1);
+    v[i] = bits_to_unit_double(((uint64_t)c2 << 32) | c3);
+  }
+}
+
+// Cuenta los lanzamientos [first, first + count) que caen dentro del círculo
+long long int count_in_circle(uint64_t seed, uint64_t first,
+                              long long int count) {
+  double x[TOSS_BATCH], y[TOSS_BATCH];
+  long long int in_circle = 0;
+
+  for (long long int done = 0; done < count; done += TOSS_BATCH) {
+    int batch = (count - done < TOSS_BATCH) ? (int)(count - done) : TOSS_BATCH;
+    philox_uniform_pairs(seed, 0, first + (uint64_t)done, batch, x, y);
+
+    // Cálculo sin saltos: el compilador lo vectoriza
+    long long int hits = 0;
+    for (int i = 0; i < batch; i++) {
+      double px = -1.0 + 2.0 * x[i];
+      double py = -1.0 + 2.0 * y[i];
+      hits += (px * px + py * py <= 1.0);
+    }
+    in_circle += hits;
+  }
+
+  return in_circle;
+}
+
+// ========== CONTADORES POR HILO ==========
+// Cada hilo acumula en su propia línea de caché (64 bytes) para que las
+// escrituras de un hilo no invaliden la línea de los demás (false sharing)
+#define CACHE_LINE 64
+
+typedef struct {
+  _Alignas(CACHE_LINE) long long int local_number_in_circle;
+  long long int tosses;
+  double seconds;
+} thread_counter_t;
+
+// Reloj por hilo: con MPI_THREAD_FUNNELED los hilos trabajadores no deben
+// llamar a MPI, ni siquiera a MPI_Wtime
+static double thread_wtime(void) {
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return MPI_Wtime();
+#endif
+}
+
+// Lanzamientos entre comprobaciones del hilo maestro (MPI_Test / progreso)
+#define TOSS_BLOCK 65536
+
+// Reparte [first, first + count) en tramos contiguos entre los hilos y
+// devuelve los aciertos. Los contadores por hilo acumulan entre llamadas.
+// Si pending no es NULL, el hilo maestro hace avanzar esa operación no
+// bloqueante mientras calcula (MPI no progresa sin llamadas a MPI).
+long long int toss_range(uint64_t seed, uint64_t first, long long int count,
+                         int num_threads, thread_counter_t *counters,
+                         MPI_Request *pending, int show_progress) {
+#pragma omp parallel num_threads(num_threads)
+  {
+#ifdef _OPENMP
+    int tid = omp_get_thread_num();
+#else
+    int tid = 0;
+#endif
+    long long int base = count / num_threads;
+    long long int extra = count % num_threads;
+    long long int my_tosses = base + (tid < extra ? 1 : 0);
+    long long int my_first = tid * base + (tid < extra ? tid : extra);
+
+    thread_counter_t *my = &counters[tid];
+    long long int hits = 0;
+    double thread_start = thread_wtime();
+
+    for (long long int i = 0; i < my_tosses; i += TOSS_BLOCK) {
+      long long int n =
+          (my_tosses - i < TOSS_BLOCK) ? my_tosses - i : TOSS_BLOCK;
+      hits += count_in_circle(seed, first + (uint64_t)(my_first + i), n);
+
+      if (tid == 0 && pending != NULL && *pending != MPI_REQUEST_NULL) {
+        int flag;
+        MPI_Test(pending, &flag, MPI_STATUS_IGNORE);
+      }
+
+      // Progreso cada ~1M de lanzamientos (solo hilo 0)
+      if (show_progress && tid == 0 && i > 0 && i % (16 * TOSS_BLOCK) == 0) {
+        printf("Progress: %lld/%lld (%.1f%%)\n", i, my_tosses,
+               (double)i / my_tosses * 100);
+      }
+    }
+
+    my->local_number_in_circle += hits;
+    my->tosses += my_tosses;
+    my->seconds += thread_wtime() - thread_start;
+  }
+
+  long long int in_circle = 0;
+  for (int t = 0; t < num_threads; t++) {
+    in_circle += counters[t].local_number_in_circle;
+  }
+  return in_circle;
+}
+
+// ========== MOTOR DE INTEGRACIÓN MONTE CARLO ==========
+// Estima la integral de f sobre una caja [lo, hi]^dim. El integrando recibe
+// lotes de puntos en formato estructura-de-arrays (x[d][i]) y escribe f[i],
+// de modo que su bucle interno sea vectorizable. Las estadísticas (n, media,
+// M2) se combinan entre hilos y procesos con la fórmula de Chan et al., que
+// es estable numéricamente; entre procesos se usa un MPI_Op propio.
+#define MC_MAX_DIM 16
+#define MC_BATCH 512
+
+typedef void (*mc_integrand_fn)(double *const *x, int dim, int count,
+                                double *restrict f);
+
+typedef struct {
+  const char *name;
+  const char *description;
+  mc_integrand_fn f;
+  double lo, hi; // mismos límites en todas las dimensiones
+  int default_dim;
+  double (*exact)(int dim); // valor exacto, para comprobar
+} mc_problem_t;
+
+typedef struct {
+  double n;    // muestras
+  double mean; // media de f
+  double m2;   // suma de cuadrados de desviaciones
+} mc_stats_t;
+
+typedef struct {
+  long long int samples;
+  double integral;  // volumen * media
+  double variance;  // varianza muestral de f
+  double std_error; // error estándar de la integral
+} mc_result_t;
+
+// Combina b en a (Chan et al.)
+static void mc_stats_merge(mc_stats_t *a, const mc_stats_t *b) {
+  if (b->n == 0.0) {
+    return;
+  }
+  double n = a->n + b->n;
+  double delta = b->mean - a->mean;
+  a->mean += delta * b->n / n;
+  a->m2 += b->m2 + delta * delta * a->n * b->n / n;
+  a->n = n;
+}
+
+// MPI_Op de usuario: inoutvec[i] = merge(inoutvec[i], invec[i])
+static void mc_stats_op(void *invec, void *inoutvec, int *len,
+                        MPI_Datatype *datatype) {
+  (void)datatype;
+  mc_stats_t *in = invec, *inout = inoutvec;
+  for (int i = 0; i < *len; i++) {
+    mc_stats_t merged = in[i];
+    mc_stats_merge(&merged, &inout[i]);
+    inout[i] = merged;
+  }
+}
+
+// --- Integrandos de ejemplo ---
+
+// Indicador del círculo unidad sobre [-1, 1]^2: la integral es π
+static void integrand_pi(double *const *x, int dim, int count,
+                         double *restrict f) {
+  (void)dim;
+  const double *restrict px = x[0], *restrict py = x[1];
+  for (int i = 0; i < count; i++) {
+    f[i] = (px[i] * px[i] + py[i] * py[i] <= 1.0) ? 1.0 : 0.0;
+  }
+}
+
+static double exact_pi(int dim) {
+  (void)dim;
+  return M_PI;
+}
+
+// Gaussiana exp(-|x|^2) sobre [-1, 1]^dim
+static void integrand_gauss(double *const *x, int dim, int count,
+                            double *restrict f) {
+  for (int i = 0; i < count; i++) {
+    f[i] = 0.0;
+  }
+  for (int d = 0; d < dim; d++) {
+    const double *restrict xd = x[d];
+    for (int i = 0; i < count; i++) {
+      f[i] += xd[i] * xd[i];
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    f[i] = exp(-f[i]);
+  }
+}
+
+static double exact_gauss(int dim) {
+  return pow(sqrt(M_PI) * erf(1.0), dim);
+}
+
+// Indicador de la bola unidad sobre [-1, 1]^dim: volumen de la hiperesfera
+static void integrand_ball(double *const *x, int dim, int count,
+                           double *restrict f) {
+  for (int i = 0; i < count; i++) {
+    f[i] = 0.0;
+  }
+  for (int d = 0; d < dim; d++) {
+    const double *restrict xd = x[d];
+    for (int i = 0; i < count; i++) {
+      f[i] += xd[i] * xd[i];
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    f[i] = (f[i] <= 1.0) ? 1.0 : 0.0;
+  }
+}
+
+static double exact_ball(int dim) {
+  return pow(M_PI, dim / 2.0) / tgamma(dim / 2.0 + 1.0);
+}
+
+static const mc_problem_t mc_problems[] = {
+    {"pi", "indicador del círculo unidad", integrand_pi, -1.0, 1.0, 2,
+     exact_pi},
+    {"gauss", "exp(-|x|^2)", integrand_gauss, -1.0, 1.0, 4, exact_gauss},
+    {"ball", "volumen de la bola unidad", integrand_ball, -1.0, 1.0, 5,
+     exact_ball},
+};
+
+const mc_problem_t *mc_find_problem(const char *name) {
+  for (size_t i = 0; i < sizeof(mc_problems) / sizeof(mc_problems[0]); i++) {
+    if (strcmp(mc_problems[i].name, name) == 0) {
+      return &mc_problems[i];
+    }
+  }
+  return NULL;
+}
+
+// Evalúa los puntos [first, first + count) del flujo y acumula en stats.
+// Las dimensiones (2j, 2j+1) usan el flujo Philox j: con dim = 2 los puntos
+// son exactamente los lanzamientos del modo π.
+void mc_sample_range(const mc_problem_t *problem, int dim, uint64_t seed,
+                     uint64_t first, long long int count, mc_stats_t *stats) {
+  double buffer[MC_MAX_DIM + 1][MC_BATCH];
+  double *x[MC_MAX_DIM + 1];
+  double f[MC_BATCH];
+  for (int d = 0; d <= MC_MAX_DIM; d++) {
+    x[d] = buffer[d];
+  }
+  const double scale = problem->hi - problem->lo;
+
+  for (long long int done = 0; done < count; done += MC_BATCH) {
+    int batch = (count - done < MC_BATCH) ? (int)(count - done) : MC_BATCH;
+
+    // Si dim es impar, la última columna de x es relleno descartado
+    for (int d = 0; d < dim; d += 2) {
+      philox_uniform_pairs(seed, (uint32_t)(d / 2), first + (uint64_t)done,
+                           batch, x[d], x[d + 1]);
+    }
+    for (int d = 0; d < dim; d++) {
+      double *restrict xd = x[d];
+      for (int i = 0; i < batch; i++) {
+        xd[i] = problem->lo + scale * xd[i];
+      }
+    }
+
+    problem->f(x, dim, batch, f);
+
+    // Estadísticas del lote en dos pasadas (vectorizables) y merge
+    double sum = 0.0;
+    for (int i = 0; i < batch; i++) {
+      sum += f[i];
+    }
+    mc_stats_t batch_stats = {batch, sum / batch, 0.0};
+    double m2 = 0.0;
+    for (int i = 0; i < batch; i++) {
+      double dev = f[i] - batch_stats.mean;
+      m2 += dev * dev;
+    }
+    batch_stats.m2 = m2;
+    mc_stats_merge(stats, &batch_stats);
+  }
+}
+
+// Integra con 'samples' puntos repartidos entre los procesos de comm (y
+// num_threads hilos por proceso). El resultado queda en todos los procesos.
+void mc_integrate(const mc_problem_t *problem, int dim, uint64_t seed,
+                  long long int samples, int num_threads, MPI_Comm comm,
+                  mc_result_t *result) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  long long int base = samples / size;
+  long long int extra = samples % size;
+  long long int local_samples = base + (rank < extra ? 1 : 0);
+  uint64_t first = (uint64_t)rank * (uint64_t)base +
+                   (uint64_t)(rank < extra ? rank : extra);
+
+  // Estadísticas por hilo, una línea de caché cada una
+  typedef struct {
+    _Alignas(CACHE_LINE) mc_stats_t stats;
+  } padded_stats_t;
+  padded_stats_t *partial =
+      aligned_alloc(CACHE_LINE, num_threads * sizeof(padded_stats_t));
+
+#pragma omp parallel num_threads(num_threads)
+  {
+#ifdef _OPENMP
+    int tid = omp_get_thread_num();
+#else
+    int tid = 0;
+#endif
+    long long int t_base = local_samples / num_threads;
+    long long int t_extra = local_samples % num_threads;
+    long long int my_count = t_base + (tid < t_extra ? 1 : 0);
+    long long int my_first = tid * t_base + (tid < t_extra ? tid : t_extra);
+
+    mc_stats_t stats = {0.0, 0.0, 0.0};
+    mc_sample_range(problem, dim, seed, first + (uint64_t)my_first, my_count,
+                    &stats);
+    partial[tid].stats = stats;
+  }
+
+  mc_stats_t local = {0.0, 0.0, 0.0};
+  for (int t = 0; t < num_threads; t++) {
+    mc_stats_merge(&local, &partial[t].stats);
+  }
+  free(partial);
+
+  // Reducción entre procesos con el MPI_Op propio
+  MPI_Datatype stats_type;
+  MPI_Op stats_op;
+  MPI_Type_contiguous(3, MPI_DOUBLE, &stats_type);
+  MPI_Type_commit(&stats_type);
+  MPI_Op_create(mc_stats_op, 1, &stats_op);
+
+  mc_stats_t global;
+  MPI_Allreduce(&local, &global, 1, stats_type, stats_op, comm);
+
+  MPI_Op_free(&stats_op);
+  MPI_Type_free(&stats_type);
+
+  double volume = pow(problem->hi - problem->lo, dim);
+  result->samples = (long long int)global.n;
+  result->variance = global.n > 1.0 ? global.m2 / (global.n - 1.0) : 0.0;
+  result->integral = volume * global.mean;
+  result->std_error =
+      global.n > 0.0 ? volume * sqrt(result->variance / global.n) : 0.0;
 }
 
 int main(int argc, char **argv) {
-  MPI_Init(&argc, &argv);
+  // Solo el hilo maestro llama a MPI (las regiones paralelas no comunican)
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 
   int rank, size;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &size);
 
   long long int total_tosses = 10000000LL;
+  unsigned long long seed = 0;
+  int seed_given = 0;
+  int num_threads = 1;
+  double target_error = 0.0;            // -e: error estándar objetivo
+  double time_budget = 0.0;             // -T: segundos máximos (modo -e)
+  long long int chunk_tosses = 1 << 20; // -c: lanzamientos por tramo
+  int dynamic = 0;                      // -d: reparto dinámico de tramos
+  const mc_problem_t *problem = NULL;   // -f: integrando del motor
+  int dim = 0;                          // -D: dimensión del integrando
+
+  // Uso: ./monte_carlo [-s semilla] [-t hilos] [-c tramo]
+  //                    [-e error [-T segundos] | -d | -f integrando [-D dim]]
+  //                    [total_tosses]
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:e:T:c:df:D:")) != -1) {
+    switch (opt) {
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+      seed_given = 1;
+      break;
+    case 't':
+      num_threads = atoi(optarg);
+      break;
+    case 'e':
+      target_error = atof(optarg);
+      break;
+    case 'T':
+      time_budget = atof(optarg);
+      break;
+    case 'c':
+      chunk_tosses = atoll(optarg);
+      break;
+    case 'd':
+      dynamic = 1;
+      break;
+    case 'f':
+      problem = mc_find_problem(optarg);
+      if (problem == NULL) {
+        if (rank == 0) {
+          fprintf(stderr, "Integrando desconocido: %s (pi, gauss, ball)\n",
+                  optarg);
+        }
+        MPI_Finalize();
+        return 1;
+      }
+      break;
+    case 'D':
+      dim = atoi(optarg);
+      break;
+    default:
+      if (rank == 0) {
+        fprintf(stderr,
+                "Uso: %s [-s semilla] [-t hilos] [-c tramo] "
+                "[-e error [-T segundos] | -d | -f integrando [-D dim]] "
+                "[total_tosses]\n",
+                argv[0]);
+      }
+      MPI_Finalize();
+      return 1;
+    }
+  }
+
+  if ((dynamic != 0) + (target_error > 0.0) + (problem != NULL) > 1) {
+    if (rank == 0) {
+      fprintf(stderr, "Las opciones -d, -e y -f son excluyentes\n");
+    }
+    MPI_Finalize();
+    return 1;
+  }
+
+#ifndef _OPENMP
+  // Compilado sin -fopenmp: modo un hilo por proceso
+  num_threads = 1;
+#endif
+  // Biblioteca MPI sin soporte de hilos: un hilo por proceso
+  if (provided < MPI_THREAD_FUNNELED && num_threads > 1) {
+    if (rank == 0) {
+      fprintf(stderr,
+              "Aviso: MPI no ofrece MPI_THREAD_FUNNELED, se usa 1 hilo\n");
+    }
+    num_threads = 1;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  if (problem != NULL) {
+    if (dim <= 0) {
+      dim = problem->default_dim;
+    }
+    if (dim > MC_MAX_DIM || (problem->f == integrand_pi && dim != 2)) {
+      if (rank == 0) {
+        fprintf(stderr, "Dimensión no válida para %s: %d\n", problem->name,
+                dim);
+      }
+      MPI_Finalize();
+      return 1;
+    }
+  }
+  if (chunk_tosses < 1) {
+    chunk_tosses = 1;
+  }
 
   if (rank == 0) {
-    if (argc == 2) {
-      total_tosses = atoll(argv[1]);
+    if (optind < argc) {
+      total_tosses = atoll(argv[optind]);
+    }
+    // Sin semilla explícita se usa la hora, pero una sola para todos los
+    // procesos: se imprime para poder reproducir la ejecución con -s
+    if (!seed_given) {
+      seed = (unsigned long long)time(NULL);
     }
     printf("=== MONTE CARLO π (OPTIMIZADO) ===\n");
     printf("Total tosses: %lld\n", total_tosses);
     printf("Processes: %d\n", size);
+    printf("Threads per process: %d\n", num_threads);
+    printf("Seed: %llu\n", seed);
+    if (target_error > 0.0) {
+      printf("Target std error: %.3e (chunk %lld tosses/process", target_error,
+             chunk_tosses);
+      if (time_budget > 0.0) {
+        printf(", budget %.1f s", time_budget);
+      }
+      printf(")\n");
+    }
+    if (problem != NULL) {
+      printf("Integration engine: %s, dim %d\n", problem->name, dim);
+    }
+    if (dynamic) {
+      printf("Dynamic scheduling: chunks of %lld tosses\n", chunk_tosses);
+    }
   }
 
   MPI_Bcast(&total_tosses, 1, MPI_LONG_LONG_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&seed, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+
+  // ===== MODO MOTOR DE INTEGRACIÓN =====
+  if (problem != NULL) {
+    mc_result_t result;
+    double engine_start = MPI_Wtime();
+    mc_integrate(problem, dim, seed, total_tosses, num_threads,
+                 MPI_COMM_WORLD, &result);
+    double engine_time = MPI_Wtime() - engine_start;
+
+    if (rank == 0) {
+      double exact = problem->exact(dim);
+      printf("\n=== INTEGRATION RESULTS ===\n");
+      printf("Integrand: %s (%s), dim %d\n", problem->name,
+             problem->description, dim);
+      printf("Samples: %lld\n", result.samples);
+      printf("Integral:  %.10f\n", result.integral);
+      printf("Exact:     %.10f\n", exact);
+      printf("Error: %.10f\n", fabs(exact - result.integral));
+      printf("Variance:  %.6e\n", result.variance);
+      printf("Std error: %.3e\n", result.std_error);
+      printf("Total time: %.2f seconds (%.2f Msamples/s)\n", engine_time,
+             result.samples / engine_time / 1e6);
+    }
 
-  long long int local_tosses = total_tosses / size;
+    MPI_Finalize();
+    return 0;
+  }
+
+  // Reparto estático: los primeros (total_tosses % size) procesos hacen un
+  // lanzamiento más, así no se pierde el resto
+  long long int base_tosses = total_tosses / size;
+  long long int extra_tosses = total_tosses % size;
+  long long int local_tosses = base_tosses + (rank < extra_tosses ? 1 : 0);
   long long int local_number_in_circle = 0;
 
-  // Semilla más simple y rápida
-  next = (unsigned long)time(NULL) + rank;
+  // Primer índice global de este proceso dentro del flujo
+  uint64_t first_toss = (uint64_t)rank * (uint64_t)base_tosses +
+                        (uint64_t)(rank < extra_tosses ? rank : extra_tosses);
 
   int cluster_id;
   if (rank < size / 3) {
@@ -51,48 +611,152 @@ int main(int argc, char **argv) {
     cluster_id = 3;
   }
 
-  printf("Process %d (Cluster %d): Starting %lld tosses...\n", rank, cluster_id,
-         local_tosses);
+  if (target_error > 0.0 || dynamic) {
+    printf("Process %d (Cluster %d): Starting %s run...\n", rank, cluster_id,
+           dynamic ? "dynamic" : "adaptive");
+  } else {
+    printf("Process %d (Cluster %d): Starting %lld tosses...\n", rank,
+           cluster_id, local_tosses);
+  }
   double start_time = MPI_Wtime();
 
-  // BUCLE OPTIMIZADO - MÁS RÁPIDO
-  for (long long int i = 0; i < local_tosses; i++) {
-    // Generación de números aleatorios
-    double x = -1.0 + 2.0 * ((double)rand() / 32767.0);
-    double y = -1.0 + 2.0 * ((double)rand() / 32767.0);
+  thread_counter_t *counters =
+      aligned_alloc(CACHE_LINE, num_threads * sizeof(thread_counter_t));
+  memset(counters, 0, num_threads * sizeof(thread_counter_t));
+  long long int local_done = 0;
+
+  if (target_error > 0.0) {
+    // ===== MODO ERROR OBJETIVO =====
+    // Ronda k: el proceso r lanza el tramo (k * size + r) del flujo. Tras cada
+    // tramo se publica (aciertos, lanzamientos, voto de tiempo) con
+    // MPI_Iallreduce y se calcula el siguiente mientras la reducción viaja.
+    // Todos deciden con los mismos totales, así que paran en la misma ronda.
+    long long int snapshot[3], global[3];
+    MPI_Request request = MPI_REQUEST_NULL;
+    long long int round = 0;
+    int stop = 0;
+
+    while (!stop) {
+      uint64_t first = ((uint64_t)round * size + rank) * (uint64_t)chunk_tosses;
+      local_number_in_circle = toss_range(seed, first, chunk_tosses,
+                                          num_threads, counters, &request, 0);
+      local_done += chunk_tosses;
+      round++;
+
+      if (round > 1) {
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+
+        double n = (double)global[1];
+        double p = global[0] / n;
+        double std_error = 4.0 * sqrt(p * (1.0 - p) / n);
+        stop = std_error < target_error || global[2] > 0 ||
+               global[1] >= total_tosses;
 
-    // Cálculo optimizado
-    if (x * x + y * y <= 1.0) {
-      local_number_in_circle++;
+        if (rank == 0 && (round % 16 == 0 || stop)) {
+          printf("Round %lld: %lld tosses, π ≈ %.10f, std error %.3e\n",
+                 round - 1, global[1], 4.0 * p, std_error);
+        }
+      }
+
+      if (!stop) {
+        snapshot[0] = local_number_in_circle;
+        snapshot[1] = local_done;
+        snapshot[2] = (time_budget > 0.0 &&
+                       MPI_Wtime() - start_time > time_budget);
+        MPI_Iallreduce(snapshot, global, 3, MPI_LONG_LONG_INT, MPI_SUM,
+                       MPI_COMM_WORLD, &request);
+      }
+    }
+  } else if (dynamic) {
+    // ===== MODO DINÁMICO =====
+    // Rank 0 expone en una ventana RMA el índice del siguiente tramo libre.
+    // Cada proceso toma tramos con MPI_Fetch_and_op (suma atómica de 1) hasta
+    // agotar el total: los nodos rápidos toman más tramos y cada lanzamiento
+    // se hace exactamente una vez. Como el flujo se indexa por lanzamiento
+    // global, el resultado es idéntico al del reparto estático.
+    long long int *next_chunk;
+    MPI_Win win;
+    MPI_Win_allocate(rank == 0 ? sizeof(long long int) : 0,
+                     sizeof(long long int), MPI_INFO_NULL, MPI_COMM_WORLD,
+                     &next_chunk, &win);
+    if (rank == 0) {
+      MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+      *next_chunk = 0;
+      MPI_Win_unlock(0, win);
     }
+    MPI_Barrier(MPI_COMM_WORLD);
 
-    // Mostrar progreso cada 1M de iteraciones (solo para rank 0)
-    if (rank == 0 && i > 0 && i % 1000000 == 0) {
-      printf("Progress: %lld/%lld (%.1f%%)\n", i, local_tosses,
-             (double)i / local_tosses * 100);
+    const long long int one = 1;
+    long long int chunks_taken = 0;
+    MPI_Win_lock_all(0, win);
+    while (1) {
+      long long int chunk;
+      MPI_Fetch_and_op(&one, &chunk, MPI_LONG_LONG_INT, 0, 0, MPI_SUM, win);
+      MPI_Win_flush(0, win);
+
+      long long int first = chunk * chunk_tosses;
+      if (first >= total_tosses) {
+        break;
+      }
+      long long int count = (total_tosses - first < chunk_tosses)
+                                ? total_tosses - first
+                                : chunk_tosses;
+      local_number_in_circle = toss_range(seed, (uint64_t)first, count,
+                                          num_threads, counters, NULL, 0);
+      local_done += count;
+      chunks_taken++;
     }
+    MPI_Win_unlock_all(win);
+    MPI_Win_free(&win);
+
+    printf("Process %d (Cluster %d): took %lld chunks (%lld tosses)\n", rank,
+           cluster_id, chunks_taken, local_done);
+  } else {
+    // ===== MODO ESTÁTICO =====
+    // Cada hilo procesa un tramo contiguo del rango del proceso, así que el
+    // resultado tampoco depende del número de hilos
+    local_number_in_circle = toss_range(seed, first_toss, local_tosses,
+                                        num_threads, counters, NULL, rank == 0);
+    local_done = local_tosses;
   }
 
   double local_time = MPI_Wtime() - start_time;
   printf("Process %d (Cluster %d): Completed in %.2f seconds\n", rank,
          cluster_id, local_time);
+  if (num_threads > 1) {
+    for (int t = 0; t < num_threads; t++) {
+      printf("Process %d thread %d: %lld tosses, %.2f Mtosses/s\n", rank, t,
+             counters[t].tosses,
+             counters[t].seconds > 0
+                 ? counters[t].tosses / counters[t].seconds / 1e6
+                 : 0.0);
+    }
+  }
+  free(counters);
 
   // Reducción rápida
-  long long int global_number_in_circle;
-  MPI_Reduce(&local_number_in_circle, &global_number_in_circle, 1,
-             MPI_LONG_LONG_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+  long long int local_totals[2] = {local_number_in_circle, local_done};
+  long long int global_totals[2];
+  MPI_Reduce(local_totals, global_totals, 2, MPI_LONG_LONG_INT, MPI_SUM, 0,
+             MPI_COMM_WORLD);
 
   if (rank == 0) {
-    double pi_estimate = 4.0 * global_number_in_circle / (double)total_tosses;
+    long long int global_number_in_circle = global_totals[0];
+    long long int done_tosses = global_totals[1];
+    double pi_estimate = 4.0 * global_number_in_circle / (double)done_tosses;
     double total_time = MPI_Wtime() - start_time;
 
     printf("\n=== RESULTS ===\n");
-    printf("Total tosses: %lld\n", total_tosses);
+    printf("Total tosses: %lld\n", done_tosses);
     printf("Points in circle: %lld\n", global_number_in_circle);
     printf("π estimate: %.10f\n", pi_estimate);
     printf("Actual π:    %.10f\n", M_PI);
     printf("Error: %.10f\n", fabs(M_PI - pi_estimate));
+    double p = global_number_in_circle / (double)done_tosses;
+    printf("Std error:   %.3e\n", 4.0 * sqrt(p * (1.0 - p) / done_tosses));
     printf("Total time: %.2f seconds\n", total_time);
+    printf("Toss rate: %.2f Mtosses/s\n",
+           done_tosses / total_time / 1e6);
 
     // Simulación simple de 3 clusters
     printf("\n=== 3-CLUSTER SIMULATION ===\n");
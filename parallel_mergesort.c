@@ -1,187 +1,2017 @@
-#include <mpi.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-
-// Función para mezclar dos arrays ordenados
-void merge(int *arr1, int size1, int *arr2, int size2, int *result) {
-  int i = 0, j = 0, k = 0;
-  while (i < size1 && j < size2) {
-    if (arr1[i] < arr2[j]) {
-      result[k++] = arr1[i++];
-    } else {
-      result[k++] = arr2[j++];
-    }
-  }
-  while (i < size1)
-    result[k++] = arr1[i++];
-  while (j < size2)
-    result[k++] = arr2[j++];
-}
-
-// QuickSort simple para ordenar localmente
-void quicksort(int *arr, int left, int right) {
-  if (left >= right)
-    return;
-
-  int pivot = arr[(left + right) / 2];
-  int i = left, j = right;
-
-  while (i <= j) {
-    while (arr[i] < pivot)
-      i++;
-    while (arr[j] > pivot)
-      j--;
-    if (i <= j) {
-      int temp = arr[i];
-      arr[i] = arr[j];
-      arr[j] = temp;
-      i++;
-      j--;
-    }
-  }
-
-  quicksort(arr, left, j);
-  quicksort(arr, i, right);
-}
-
-int main(int argc, char **argv) {
-  MPI_Init(&argc, &argv);
-
-  int rank, size;
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-  MPI_Comm_size(MPI_COMM_WORLD, &size);
-
-  // ========== CONFIGURACIÓN ==========
-  int n = 32; // Total de elementos
-  if (argc > 1)
-    n = atoi(argv[1]);
-
-  if (n % size != 0)
-    n = (n / size) * size; // Ajustar para división exacta
-
-  int local_size = n / size;
-  int *local_data = malloc(local_size * sizeof(int));
-
-  // Proceso 0 lee n y distribuye
-  MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(&local_size, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-  // ========== GENERAR Y ORDENAR DATOS LOCALES ==========
-  srand(time(NULL) + rank); // Semilla diferente por proceso
-
-  for (int i = 0; i < local_size; i++) {
-    local_data[i] = rand() % 1000; // Números entre 0-999
-  }
-
-  // Ordenar localmente
-  quicksort(local_data, 0, local_size - 1);
-
-  // ========== PROCESO 0 MUESTRA LISTAS LOCALES ==========
-  if (rank == 0) {
-    printf("=== MERGE SORT PARALELO ===\n");
-    printf("Total elementos: %d, Procesos: %d, Elementos/proceso: %d\n\n", n,
-           size, local_size);
-
-    // Recolectar y mostrar listas locales
-    int *all_local = malloc(n * sizeof(int));
-    MPI_Gather(local_data, local_size, MPI_INT, all_local, local_size, MPI_INT,
-               0, MPI_COMM_WORLD);
-
-    printf("Listas locales ordenadas:\n");
-    for (int proc = 0; proc < size; proc++) {
-      printf("Proceso %d: [", proc);
-      for (int i = 0; i < local_size; i++) {
-        printf("%d", all_local[proc * local_size + i]);
-        if (i < local_size - 1)
-          printf(", ");
-      }
-      printf("]\n");
-    }
-    printf("\n");
-    free(all_local);
-  } else {
-    MPI_Gather(local_data, local_size, MPI_INT, NULL, 0, MPI_INT, 0,
-               MPI_COMM_WORLD);
-  }
-
-  // ========== MERGE SORT PARALELO (ÁRBOL BINARIO) ==========
-  int current_size = local_size;
-  int *current_data = local_data;
-  int step = 1;
-
-  while (step < size) {
-    int partner = rank ^ step; // Pareja usando XOR
-
-    if (partner < size) {
-      if (rank < partner) {
-        // Recibir datos del partner y mezclar
-        int partner_size;
-        MPI_Recv(&partner_size, 1, MPI_INT, partner, 0, MPI_COMM_WORLD,
-                 MPI_STATUS_IGNORE);
-
-        int *partner_data = malloc(partner_size * sizeof(int));
-        MPI_Recv(partner_data, partner_size, MPI_INT, partner, 0,
-                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-        // Mezclar
-        int new_size = current_size + partner_size;
-        int *new_data = malloc(new_size * sizeof(int));
-        merge(current_data, current_size, partner_data, partner_size, new_data);
-
-        // Actualizar
-        if (current_data != local_data)
-          free(current_data);
-        free(partner_data);
-        current_data = new_data;
-        current_size = new_size;
-
-      } else {
-        // Enviar datos al partner y terminar
-        MPI_Send(&current_size, 1, MPI_INT, partner, 0, MPI_COMM_WORLD);
-        MPI_Send(current_data, current_size, MPI_INT, partner, 0,
-                 MPI_COMM_WORLD);
-
-        if (current_data != local_data)
-          free(current_data);
-        current_data = NULL;
-        current_size = 0;
-        break;
-      }
-    }
-
-    step *= 2; // Siguiente nivel del árbol
-  }
-
-  // ========== PROCESO 0 MUESTRA RESULTADO FINAL ==========
-  if (rank == 0) {
-    printf("Lista final ordenada (%d elementos):\n[", current_size);
-    for (int i = 0; i < current_size; i++) {
-      printf("%d", current_data[i]);
-      if (i < current_size - 1)
-        printf(", ");
-      if (i > 0 && i % 20 == 0)
-        printf("\n "); // Nueva línea cada 20 elementos
-    }
-    printf("]\n");
-
-    // Verificar que está ordenado
-    int sorted = 1;
-    for (int i = 1; i < current_size; i++) {
-      if (current_data[i] < current_data[i - 1]) {
-        sorted = 0;
-        break;
-      }
-    }
-    printf("\n✅ Lista %sordenada correctamente\n", sorted ? "" : "NO ");
-  }
-
-  // ========== LIMPIEZA ==========
-  if (current_data != NULL && current_data != local_data) {
-    free(current_data);
-  }
-  free(local_data);
-
-  MPI_Finalize();
-  return 0;
-}
+#include <limits.h>
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Elementos que se imprimen como máximo
+#define PRINT_MAX 64
+
+// Función para mezclar dos arrays ordenados
+void merge(int *arr1, int size1, int *arr2, int size2, int *result) {
+  int i = 0, j = 0, k = 0;
+  while (i < size1 && j < size2) {
+    if (arr1[i] < arr2[j]) {
+      result[k++] = arr1[i++];
+    } else {
+      result[k++] = arr2[j++];
+    }
+  }
+  while (i < size1)
+    result[k++] = arr1[i++];
+  while (j < size2)
+    result[k++] = arr2[j++];
+}
+
+// QuickSort simple para ordenar localmente
+void quicksort(int *arr, long long int left, long long int right) {
+  if (left >= right)
+    return;
+
+  int pivot = arr[(left + right) / 2];
+  long long int i = left, j = right;
+
+  while (i <= j) {
+    while (arr[i] < pivot)
+      i++;
+    while (arr[j] > pivot)
+      j--;
+    if (i <= j) {
+      int temp = arr[i];
+      arr[i] = arr[j];
+      arr[j] = temp;
+      i++;
+      j--;
+    }
+  }
+
+  quicksort(arr, left, j);
+  quicksort(arr, i, right);
+}
+
+// ========== RADIX SORT LSD (CLAVES ENTERAS) ==========
+// Ordena por dígitos de bits bits (8 u 11), del menos al más significativo.
+// Un solo recorrido calcula los histogramas de todas las pasadas; cada pasada
+// convierte su histograma en desplazamientos (suma prefija) y reparte los
+// elementos a través de búferes de escritura combinada: un búfer de una
+// línea de caché por cubeta que se vuelca entero con memcpy, de modo que la
+// memoria destino recibe líneas completas en lugar de escrituras sueltas a
+// 2^bits posiciones distintas. Se saltan las pasadas cuyo dígito es igual en
+// todos los elementos (p. ej. los bits altos de valores pequeños).
+// scratch es un búfer de n enteros para las pasadas impares; con NULL se
+// reserva aquí.
+#define RADIX_WC 16 // Enteros por búfer de escritura combinada (64 bytes)
+
+void radix_sort(int *arr, long long int n, int bits, int *scratch) {
+  if (n < 2)
+    return;
+
+  int buckets = 1 << bits;
+  int passes = (32 + bits - 1) / bits;
+  unsigned int mask = buckets - 1;
+  unsigned int *src = (unsigned int *)arr;
+  unsigned int *tmp =
+      scratch ? (unsigned int *)scratch : malloc(n * sizeof(unsigned int));
+  unsigned int *dst = tmp;
+  long long int *hist = calloc(passes * buckets, sizeof(long long int));
+  long long int *offset = malloc(buckets * sizeof(long long int));
+  int *wc_fill = malloc(buckets * sizeof(int));
+  unsigned int *wc =
+      aligned_alloc(64, buckets * RADIX_WC * sizeof(unsigned int));
+
+  // Invertir el bit de signo: el orden sin signo coincide con el de int
+  for (long long int i = 0; i < n; i++) {
+    unsigned int u = src[i] ^ 0x80000000u;
+    src[i] = u;
+    for (int p = 0; p < passes; p++)
+      hist[p * buckets + ((u >> (p * bits)) & mask)]++;
+  }
+
+  for (int p = 0; p < passes; p++) {
+    long long int *h = hist + p * buckets;
+    int shift = p * bits;
+
+    // Dígito constante: la pasada no cambiaría el orden
+    if (h[(src[0] >> shift) & mask] == n)
+      continue;
+
+    long long int sum = 0;
+    for (int b = 0; b < buckets; b++) {
+      offset[b] = sum;
+      sum += h[b];
+      wc_fill[b] = 0;
+    }
+
+    for (long long int i = 0; i < n; i++) {
+      unsigned int u = src[i];
+      unsigned int d = (u >> shift) & mask;
+      unsigned int *line = wc + d * RADIX_WC;
+      line[wc_fill[d]++] = u;
+      if (wc_fill[d] == RADIX_WC) {
+        memcpy(dst + offset[d], line, RADIX_WC * sizeof(unsigned int));
+        offset[d] += RADIX_WC;
+        wc_fill[d] = 0;
+      }
+    }
+    for (int b = 0; b < buckets; b++)
+      memcpy(dst + offset[b], wc + b * RADIX_WC,
+             wc_fill[b] * sizeof(unsigned int));
+
+    unsigned int *swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  // Número impar de pasadas efectivas: el resultado quedó en tmp
+  if (src != (unsigned int *)arr)
+    memcpy(arr, src, n * sizeof(unsigned int));
+  for (long long int i = 0; i < n; i++)
+    arr[i] = (int)((unsigned int)arr[i] ^ 0x80000000u);
+
+  if (scratch == NULL)
+    free(tmp);
+  free(hist);
+  free(offset);
+  free(wc_fill);
+  free(wc);
+}
+
+// Ordenación local elegida con -k: quicksort (radix_bits == 0) o radix sort
+// (scratch como en radix_sort; quicksort no lo usa)
+void local_sort(int *arr, long long int n, int radix_bits, int *scratch) {
+  if (radix_bits > 0)
+    radix_sort(arr, n, radix_bits, scratch);
+  else
+    quicksort(arr, 0, n - 1);
+}
+
+// Compara quicksort y radix sort (8 y 11 bits) en el proceso 0 con tamaños
+// crecientes hasta max_n, para valores 0-999 (los del programa) y para el
+// rango completo de int con negativos. Comprueba que los resultados coinciden.
+void benchmark_local_sort(int max_n) {
+  const char *names[2] = {"0-999", "int completo"};
+  printf("=== BENCHMARK ORDENACIÓN LOCAL (Melem/s) ===\n");
+  printf("%10s %-13s %10s %10s %10s\n", "n", "valores", "quicksort",
+         "radix8", "radix11");
+
+  for (int n = 10000; n <= max_n; n *= 10) {
+    int *input = malloc(n * sizeof(int));
+    int *reference = malloc(n * sizeof(int));
+    int *work = malloc(n * sizeof(int));
+
+    for (int dist = 0; dist < 2; dist++) {
+      srand(12345 + dist);
+      for (int i = 0; i < n; i++)
+        input[i] = dist == 0 ? rand() % 1000
+                             : (int)(((unsigned int)rand() << 16) ^
+                                     (unsigned int)rand());
+
+      double rate[3];
+      int ok = 1;
+      for (int kernel = 0; kernel < 3; kernel++) {
+        int radix_bits = kernel == 0 ? 0 : (kernel == 1 ? 8 : 11);
+        memcpy(work, input, n * sizeof(int));
+        double start = MPI_Wtime();
+        local_sort(work, n, radix_bits, NULL);
+        rate[kernel] = n / (MPI_Wtime() - start) / 1e6;
+        if (kernel == 0)
+          memcpy(reference, work, n * sizeof(int));
+        else if (memcmp(reference, work, n * sizeof(int)) != 0)
+          ok = 0;
+      }
+      printf("%10d %-13s %10.1f %10.1f %10.1f%s\n", n, names[dist], rate[0],
+             rate[1], rate[2], ok ? "" : "  ❌ resultados distintos");
+    }
+
+    free(input);
+    free(reference);
+    free(work);
+    if (n > max_n / 10)
+      break; // Evitar desbordamiento de n *= 10
+  }
+}
+
+// ========== MEZCLA SIN SALTOS Y MEZCLA BITÓNICA SIMD ==========
+// En merge() el salto depende de los datos y con valores aleatorios falla
+// la predicción la mitad de las veces. La versión sin saltos elige el
+// elemento y avanza los índices con aritmética (cmov).
+void merge_branchless(const int *arr1, long long int size1, const int *arr2,
+                      long long int size2, int *result) {
+  long long int i = 0, j = 0, k = 0;
+  while (i < size1 && j < size2) {
+    int x = arr1[i], y = arr2[j];
+    int take1 = x <= y;
+    result[k++] = take1 ? x : y;
+    i += take1;
+    j += 1 - take1;
+  }
+  memcpy(result + k, arr1 + i, (size1 - i) * sizeof(int));
+  k += size1 - i;
+  memcpy(result + k, arr2 + j, (size2 - j) * sizeof(int));
+}
+
+#ifdef __AVX2__
+// Ordena un vector bitónico de 8 enteros: comparadores a distancia 4, 2 y 1
+static inline __m256i bitonic_clean8(__m256i v) {
+  __m256i p = _mm256_permute2x128_si256(v, v, 0x01);
+  v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p),
+                         0xF0);
+  p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+  v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p),
+                         0xCC);
+  p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+  return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p),
+                            0xAA);
+}
+
+// Red de mezcla bitónica de 16 elementos: a y b ordenados de 8 en 8; al
+// salir a tiene los 8 menores y b los 8 mayores, ambos ordenados
+static inline void bitonic_merge16(__m256i *a, __m256i *b) {
+  const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+  __m256i rb = _mm256_permutevar8x32_epi32(*b, reverse);
+  __m256i lo = _mm256_min_epi32(*a, rb);
+  __m256i hi = _mm256_max_epi32(*a, rb);
+  *a = bitonic_clean8(lo);
+  *b = bitonic_clean8(hi);
+}
+
+// Mezcla con bloques de 8 en registros AVX2: cada paso mezcla el bloque
+// pendiente con el siguiente bloque de la lista cuya cabeza es menor, emite
+// los 8 menores y guarda los 8 mayores. Cuando a una lista le quedan menos
+// de 8 elementos, el bloque pendiente y esa cola se mezclan en un búfer
+// pequeño y el resto se completa con la mezcla sin saltos.
+void merge_bitonic(const int *arr1, long long int size1, const int *arr2,
+                   long long int size2, int *result) {
+  if (size1 < 8 || size2 < 8) {
+    merge_branchless(arr1, size1, arr2, size2, result);
+    return;
+  }
+
+  __m256i a = _mm256_loadu_si256((const __m256i *)arr1);
+  __m256i b = _mm256_loadu_si256((const __m256i *)arr2);
+  long long int i = 8, j = 8, k = 0;
+  while (1) {
+    bitonic_merge16(&a, &b);
+    _mm256_storeu_si256((__m256i *)(result + k), a);
+    k += 8;
+    if (i + 8 > size1 || j + 8 > size2)
+      break;
+    // Siguiente bloque de la lista con la cabeza menor
+    if (arr1[i] <= arr2[j]) {
+      a = _mm256_loadu_si256((const __m256i *)(arr1 + i));
+      i += 8;
+    } else {
+      a = _mm256_loadu_si256((const __m256i *)(arr2 + j));
+      j += 8;
+    }
+  }
+
+  // Colas: el bloque pendiente con la lista corta, luego con la otra
+  int pending[8], small[16];
+  _mm256_storeu_si256((__m256i *)pending, b);
+  if (i + 8 > size1) {
+    merge_branchless(pending, 8, arr1 + i, size1 - i, small);
+    merge_branchless(small, 8 + size1 - i, arr2 + j, size2 - j, result + k);
+  } else {
+    merge_branchless(pending, 8, arr2 + j, size2 - j, small);
+    merge_branchless(small, 8 + size2 - j, arr1 + i, size1 - i, result + k);
+  }
+}
+#endif
+
+// Núcleo de mezcla usado por el árbol: SIMD si se compiló con AVX2
+// (-march=native), si no la versión escalar sin saltos
+void merge_fast(const int *arr1, long long int size1, const int *arr2,
+                long long int size2, int *result) {
+#ifdef __AVX2__
+  merge_bitonic(arr1, size1, arr2, size2, result);
+#else
+  merge_branchless(arr1, size1, arr2, size2, result);
+#endif
+}
+
+// Compara merge() con las mezclas sin saltos y bitónica en el proceso 0:
+// dos listas ordenadas de n / 2 valores aleatorios de rango completo
+void benchmark_merge(int max_n) {
+  printf("\n=== BENCHMARK MEZCLA DE DOS LISTAS (Melem/s) ===\n");
+  printf("%10s %10s %10s %10s\n", "n", "merge", "sin saltos", "bitonica");
+
+  for (int n = 10000; n <= max_n; n *= 10) {
+    int half = n / 2;
+    int *input = malloc(n * sizeof(int));
+    int *reference = malloc(n * sizeof(int));
+    int *work = malloc(n * sizeof(int));
+    srand(54321);
+    for (int i = 0; i < n; i++)
+      input[i] = (int)(((unsigned int)rand() << 16) ^ (unsigned int)rand());
+    radix_sort(input, half, 11, NULL);
+    radix_sort(input + half, n - half, 11, NULL);
+
+    double rate[3] = {0, 0, 0};
+    int ok = 1;
+    for (int kernel = 0; kernel < 3; kernel++) {
+#ifndef __AVX2__
+      if (kernel == 2)
+        break;
+#endif
+      double best = 1e30;
+      for (int rep = 0; rep < 5; rep++) {
+        double start = MPI_Wtime();
+        if (kernel == 0)
+          merge(input, half, input + half, n - half, work);
+        else if (kernel == 1)
+          merge_branchless(input, half, input + half, n - half, work);
+#ifdef __AVX2__
+        else
+          merge_bitonic(input, half, input + half, n - half, work);
+#endif
+        double elapsed = MPI_Wtime() - start;
+        if (elapsed < best)
+          best = elapsed;
+      }
+      rate[kernel] = n / best / 1e6;
+      if (kernel == 0)
+        memcpy(reference, work, n * sizeof(int));
+      else if (memcmp(reference, work, n * sizeof(int)) != 0)
+        ok = 0;
+    }
+    printf("%10d %10.1f %10.1f ", n, rate[0], rate[1]);
+    if (rate[2] > 0)
+      printf("%10.1f", rate[2]);
+    else
+      printf("%10s", "(sin AVX2)");
+    printf("%s\n", ok ? "" : "  ❌ resultados distintos");
+
+    free(input);
+    free(reference);
+    free(work);
+    if (n > max_n / 10)
+      break; // Evitar desbordamiento de n *= 10
+  }
+}
+
+// ========== MEZCLA EN ÁRBOL SEGMENTADA ==========
+// El receptor conoce el tamaño de la lista del partner (los tamaños de todos
+// los procesos se deducen de n con block_start()), así que no hace falta un
+// mensaje previo con el tamaño. La lista se transmite en bloques de
+// MERGE_CHUNK enteros con un MPI_Irecv por bloque: la mezcla avanza sobre
+// los bloques ya recibidos mientras llegan los siguientes. Los bloques
+// también mantienen cada mensaje por debajo del límite de int de MPI.
+#define MERGE_CHUNK (1 << 16) // Enteros por bloque (256 KiB)
+
+// Primer elemento global del proceso r al repartir n sin truncar: los
+// n % size primeros procesos tienen un elemento más
+long long int block_start(long long int n, int size, int r) {
+  long long int extra = n % size;
+  return r * (n / size) + (r < extra ? r : extra);
+}
+
+// Envía count enteros en bloques de MERGE_CHUNK (deben coincidir con los
+// MPI_Irecv del receptor)
+void send_chunked(const int *data, long long int count, int dest,
+                  MPI_Request *reqs, MPI_Comm comm) {
+  long long int chunks = 0;
+  for (long long int offset = 0; offset < count; offset += MERGE_CHUNK) {
+    int len = count - offset < MERGE_CHUNK ? count - offset : MERGE_CHUNK;
+    MPI_Isend(data + offset, len, MPI_INT, dest, 0, comm, &reqs[chunks++]);
+  }
+  MPI_Waitall(chunks, reqs, MPI_STATUSES_IGNORE);
+}
+
+// Recibe count enteros en bloques de MERGE_CHUNK sin mezclarlos
+void recv_chunked(int *data, long long int count, int source,
+                  MPI_Request *reqs, MPI_Comm comm) {
+  long long int chunks = 0;
+  for (long long int offset = 0; offset < count; offset += MERGE_CHUNK) {
+    int len = count - offset < MERGE_CHUNK ? count - offset : MERGE_CHUNK;
+    MPI_Irecv(data + offset, len, MPI_INT, source, 0, comm, &reqs[chunks++]);
+  }
+  MPI_Waitall(chunks, reqs, MPI_STATUSES_IGNORE);
+}
+
+// Recibe partner_size enteros del proceso source justo detrás de los
+// current_size de current (el búfer tiene capacidad para ambos) y mezcla
+// las dos listas en result a medida que se completan los bloques.
+void merge_pipelined(int *current, long long int current_size,
+                     long long int partner_size, int source,
+                     MPI_Request *reqs, int *result, MPI_Comm comm) {
+  int *partner = current + current_size;
+  long long int chunks = 0;
+  for (long long int offset = 0; offset < partner_size;
+       offset += MERGE_CHUNK) {
+    int len = partner_size - offset < MERGE_CHUNK ? partner_size - offset
+                                                  : MERGE_CHUNK;
+    MPI_Irecv(partner + offset, len, MPI_INT, source, 0, comm,
+              &reqs[chunks++]);
+  }
+
+  long long int i = 0, j = 0, k = 0;
+  for (long long int c = 0; c < chunks; c++) {
+    // Los mensajes del mismo origen y etiqueta llegan en orden
+    MPI_Wait(&reqs[c], MPI_STATUS_IGNORE);
+    long long int available = (c + 1) * MERGE_CHUNK;
+    if (available > partner_size)
+      available = partner_size;
+
+    // Los elementos propios <= último recibido, mezclados con el bloque,
+    // son el siguiente tramo del resultado (el último bloque cierra todo)
+    long long int upto = current_size;
+    if (available < partner_size) {
+      long long int lo = i, hi = current_size;
+      while (lo < hi) {
+        long long int mid = lo + (hi - lo) / 2;
+        if (current[mid] <= partner[available - 1])
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      upto = lo;
+    }
+    merge_fast(current + i, upto - i, partner + j, available - j, result + k);
+    k += (upto - i) + (available - j);
+    i = upto;
+    j = available;
+  }
+  memcpy(result + k, current + i, (current_size - i) * sizeof(int));
+}
+
+// ========== ÁRBOL DE PERDEDORES ==========
+// Torneo sobre k listas: las hojas son las cabezas de cada lista (key[i]) y
+// cada nodo interno guarda el perdedor de su partido; node[0] guarda el
+// ganador (la lista con la menor cabeza). Tras consumir la cabeza ganadora
+// solo se rejuega el camino de esa hoja a la raíz: log2(k) comparaciones,
+// frente a las ~2 log2(k) de un montículo. Las claves son de 64 bits para
+// representar una lista agotada con LLONG_MAX sin confundirla con INT_MAX.
+typedef struct {
+  int k;
+  int *node;      // node[0]: ganador; node[1..k-1]: perdedores
+  long long *key; // Cabeza de cada lista (LLONG_MAX = agotada)
+} loser_tree_t;
+
+void loser_tree_init(loser_tree_t *tree, long long *keys, int k) {
+  tree->k = k;
+  tree->key = keys;
+  tree->node = malloc((k > 0 ? k : 1) * sizeof(int));
+
+  // Ganadores de cada subárbol (hojas en las posiciones k..2k-1)
+  int *winner = malloc(2 * k * sizeof(int));
+  for (int i = 0; i < k; i++)
+    winner[k + i] = i;
+  for (int n = k - 1; n > 0; n--) {
+    int a = winner[2 * n], b = winner[2 * n + 1];
+    int a_wins = keys[a] <= keys[b];
+    winner[n] = a_wins ? a : b;
+    tree->node[n] = a_wins ? b : a;
+  }
+  tree->node[0] = k > 1 ? winner[1] : 0;
+  free(winner);
+}
+
+// Rejuega el camino del último ganador tras cambiar su clave. El bucle no
+// tiene saltos dependientes de los datos: el compilador usa cmov.
+static inline void loser_tree_replay(loser_tree_t *tree) {
+  int w = tree->node[0];
+  for (int n = (w + tree->k) / 2; n > 0; n /= 2) {
+    int l = tree->node[n];
+    int swap = tree->key[l] < tree->key[w];
+    tree->node[n] = swap ? w : l;
+    w = swap ? l : w;
+  }
+  tree->node[0] = w;
+}
+
+void loser_tree_free(loser_tree_t *tree) { free(tree->node); }
+
+// ========== MEZCLA DE K LISTAS ORDENADAS ==========
+// Mezcla k listas ordenadas en una sola pasada: la lista r empieza en
+// data + starts[r] y tiene counts[r] elementos. El resultado se escribe en
+// result. Con el árbol de perdedores cada elemento de salida cuesta log2(k)
+// comparaciones sin saltos, y los datos se leen y escriben una sola vez en
+// lugar de log2(k) veces con mezclas por parejas.
+void kway_merge(const int *data, const long long int *starts,
+                const long long int *counts, int k, int *result) {
+  long long *keys = malloc((k > 0 ? k : 1) * sizeof(long long));
+  long long int *pos = calloc(k > 0 ? k : 1, sizeof(long long int));
+  long long int total = 0;
+  for (int r = 0; r < k; r++) {
+    keys[r] = counts[r] > 0 ? data[starts[r]] : LLONG_MAX;
+    total += counts[r];
+  }
+
+  loser_tree_t tree;
+  loser_tree_init(&tree, keys, k);
+  for (long long int out = 0; out < total; out++) {
+    int w = tree.node[0];
+    result[out] = (int)keys[w];
+    long long int p = ++pos[w];
+    keys[w] = p < counts[w] ? data[starts[w] + p] : LLONG_MAX;
+    loser_tree_replay(&tree);
+  }
+
+  loser_tree_free(&tree);
+  free(keys);
+  free(pos);
+}
+
+// Parte una lista ordenada en size cubetas: la cubeta r lleva los valores
+// <= splitters[r] (la última, el resto). Cada corte es una búsqueda binaria.
+void partition_by_splitters(const int *data, long long int count,
+                            const int *splitters, int size,
+                            long long int *counts, long long int *displs) {
+  long long int start = 0;
+  for (int r = 0; r < size; r++) {
+    long long int end = count;
+    if (r < size - 1) {
+      // Primer índice con valor > splitters[r]
+      long long int lo = start, hi = count;
+      while (lo < hi) {
+        long long int mid = lo + (hi - lo) / 2;
+        if (data[mid] <= splitters[r])
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      end = lo;
+    }
+    displs[r] = start;
+    counts[r] = end - start;
+    start = end;
+  }
+}
+
+// ========== INTERCAMBIO TODOS CON TODOS DE 64 BITS ==========
+// MPI_Alltoallv usa cuentas y desplazamientos int, y las variantes de
+// cuenta grande (MPI_Alltoallv_c, MPI 4) no están en la versión instalada.
+// Si todo cabe en int se usa MPI_Alltoallv; si no, cada pareja de procesos
+// intercambia su cubeta en bloques de EXCHANGE_CHUNK con MPI_Isend/Irecv.
+// La decisión es colectiva (MPI_Allreduce) para que todos sigan el mismo
+// camino. Cuentas y desplazamientos van en elementos de type (MPI_INT para
+// las claves, el tipo contiguo de un registro en la ordenación de
+// registros).
+#ifndef EXCHANGE_INT_LIMIT
+#define EXCHANGE_INT_LIMIT INT_MAX
+#endif
+#ifndef EXCHANGE_CHUNK
+#define EXCHANGE_CHUNK (1 << 26) // Elementos por mensaje (256 MiB de int)
+#endif
+
+void alltoallv_large(const void *send, const long long int *send_counts,
+                     const long long int *send_displs, void *recv,
+                     const long long int *recv_counts,
+                     const long long int *recv_displs, MPI_Datatype type,
+                     MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  MPI_Aint lb, extent;
+  MPI_Type_get_extent(type, &lb, &extent);
+  const char *send_bytes = send;
+  char *recv_bytes = recv;
+
+  int fits = 1, all_fit;
+  for (int r = 0; r < size; r++)
+    if (send_displs[r] + send_counts[r] > EXCHANGE_INT_LIMIT ||
+        recv_displs[r] + recv_counts[r] > EXCHANGE_INT_LIMIT)
+      fits = 0;
+  MPI_Allreduce(&fits, &all_fit, 1, MPI_INT, MPI_LAND, comm);
+
+  if (all_fit) {
+    int *counts = malloc(4 * size * sizeof(int));
+    for (int r = 0; r < size; r++) {
+      counts[r] = send_counts[r];
+      counts[size + r] = send_displs[r];
+      counts[2 * size + r] = recv_counts[r];
+      counts[3 * size + r] = recv_displs[r];
+    }
+    MPI_Alltoallv(send, counts, counts + size, type, recv, counts + 2 * size,
+                  counts + 3 * size, type, comm);
+    free(counts);
+    return;
+  }
+
+  // Camino de cuenta grande: bloques punto a punto (mismo origen y
+  // etiqueta, así que llegan en orden)
+  long long int messages = 0;
+  for (int r = 0; r < size; r++)
+    if (r != rank)
+      messages += (send_counts[r] + EXCHANGE_CHUNK - 1) / EXCHANGE_CHUNK +
+                  (recv_counts[r] + EXCHANGE_CHUNK - 1) / EXCHANGE_CHUNK;
+  MPI_Request *reqs = malloc((messages > 0 ? messages : 1) *
+                             sizeof(MPI_Request));
+  long long int m = 0;
+  for (int r = 0; r < size; r++) {
+    if (r == rank)
+      continue;
+    for (long long int off = 0; off < recv_counts[r]; off += EXCHANGE_CHUNK) {
+      int len = recv_counts[r] - off < EXCHANGE_CHUNK ? recv_counts[r] - off
+                                                      : EXCHANGE_CHUNK;
+      MPI_Irecv(recv_bytes + (recv_displs[r] + off) * extent, len, type, r, 0,
+                comm, &reqs[m++]);
+    }
+  }
+  for (int r = 0; r < size; r++) {
+    if (r == rank)
+      continue;
+    for (long long int off = 0; off < send_counts[r]; off += EXCHANGE_CHUNK) {
+      int len = send_counts[r] - off < EXCHANGE_CHUNK ? send_counts[r] - off
+                                                      : EXCHANGE_CHUNK;
+      MPI_Isend(send_bytes + (send_displs[r] + off) * extent, len, type, r, 0,
+                comm, &reqs[m++]);
+    }
+  }
+  memcpy(recv_bytes + recv_displs[rank] * extent,
+         send_bytes + send_displs[rank] * extent, send_counts[rank] * extent);
+  MPI_Waitall(m, reqs, MPI_STATUSES_IGNORE);
+  free(reqs);
+}
+
+// ========== SAMPLE SORT (PSRS) ==========
+// Ordenación por muestreo regular: ningún proceso queda ocioso ni recibe
+// todos los datos. Cada proceso ordena localmente, aporta size muestras
+// equiespaciadas, el proceso 0 elige size - 1 separadores entre las size^2
+// muestras y los difunde; cada proceso parte sus datos por los separadores,
+// un intercambio todos con todos entrega a cada proceso su cubeta y una
+// mezcla de size listas la deja ordenada. El resultado queda repartido: el
+// proceso r tiene valores <= que los del proceso r + 1.
+// Devuelve el arreglo local ordenado (nuevo) y su tamaño en out_size.
+int *sample_sort(int *local_data, long long int local_size,
+                 long long int *out_size, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  // Los datos ya vienen ordenados localmente: muestras regulares
+  int *samples = malloc(size * sizeof(int));
+  for (int i = 0; i < size; i++) {
+    long long int index = i * local_size / size;
+    samples[i] = local_size > 0 ? local_data[index] : INT_MAX;
+  }
+
+  int *all_samples = NULL;
+  if (rank == 0)
+    all_samples = malloc(size * size * sizeof(int));
+  MPI_Gather(samples, size, MPI_INT, all_samples, size, MPI_INT, 0, comm);
+
+  // Separadores: muestras en las posiciones size, 2*size, ... ordenadas
+  int *splitters = malloc((size > 1 ? size - 1 : 1) * sizeof(int));
+  if (rank == 0) {
+    quicksort(all_samples, 0, size * size - 1);
+    for (int i = 1; i < size; i++)
+      splitters[i - 1] = all_samples[i * size + size / 2 - 1];
+    free(all_samples);
+  }
+  MPI_Bcast(splitters, size - 1, MPI_INT, 0, comm);
+
+  // Partir los datos locales: la cubeta r lleva los valores <= splitters[r]
+  long long int *send_counts = malloc(size * sizeof(long long int));
+  long long int *send_displs = malloc(size * sizeof(long long int));
+  partition_by_splitters(local_data, local_size, splitters, size, send_counts,
+                         send_displs);
+
+  long long int *recv_counts = malloc(size * sizeof(long long int));
+  long long int *recv_displs = malloc(size * sizeof(long long int));
+  MPI_Alltoall(send_counts, 1, MPI_LONG_LONG_INT, recv_counts, 1,
+               MPI_LONG_LONG_INT, comm);
+  long long int total = 0;
+  for (int r = 0; r < size; r++) {
+    recv_displs[r] = total;
+    total += recv_counts[r];
+  }
+
+  int *received = malloc((total > 0 ? total : 1) * sizeof(int));
+  alltoallv_large(local_data, send_counts, send_displs, received, recv_counts,
+                  recv_displs, MPI_INT, comm);
+
+  // Cada bloque recibido ya está ordenado: mezcla de size listas
+  int *result = malloc((total > 0 ? total : 1) * sizeof(int));
+  kway_merge(received, recv_displs, recv_counts, size, result);
+
+  free(samples);
+  free(splitters);
+  free(send_counts);
+  free(send_displs);
+  free(recv_counts);
+  free(recv_displs);
+  free(received);
+
+  *out_size = total;
+  return result;
+}
+
+// Comprobación global de un resultado repartido a partir de un resumen
+// local: si la lista local está ordenada, su primer y último valor, el
+// número de elementos y su suma. El máximo de los procesos anteriores
+// (MPI_Exscan) no debe superar el primer elemento local, y el total y la
+// suma de los elementos se conservan.
+int verify_summary(int local_ok, int first, int last, long long int count,
+                   long long int sum, long long int n, long long int checksum,
+                   MPI_Comm comm) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  int ok = local_ok;
+  int local_max = count > 0 ? last : INT_MIN;
+  int previous_max = INT_MIN;
+  MPI_Exscan(&local_max, &previous_max, 1, MPI_INT, MPI_MAX, comm);
+  if (rank == 0)
+    previous_max = INT_MIN; // MPI_Exscan no define el valor en rank 0
+  if (count > 0 && previous_max > first)
+    ok = 0;
+
+  long long int local_stats[2] = {count, sum}, stats[2];
+  int all_ok;
+  MPI_Allreduce(local_stats, stats, 2, MPI_LONG_LONG_INT, MPI_SUM, comm);
+  MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+  return all_ok && stats[0] == n && stats[1] == checksum;
+}
+
+// Verifica un resultado repartido en memoria sin reunirlo
+int verify_distributed(const int *data, long long int local_size,
+                       long long int n, long long int checksum,
+                       MPI_Comm comm) {
+  int ok = 1;
+  long long int local_sum = 0;
+  for (long long int i = 0; i < local_size; i++) {
+    if (i > 0 && data[i] < data[i - 1])
+      ok = 0;
+    local_sum += data[i];
+  }
+  return verify_summary(ok, local_size > 0 ? data[0] : 0,
+                        local_size > 0 ? data[local_size - 1] : 0, local_size,
+                        local_sum, n, checksum, comm);
+}
+
+// ========== ORDENACIÓN EXTERNA ==========
+// Para datos que no caben en la memoria de todos los procesos juntos.
+// Fase 1: cada proceso lee muestras equiespaciadas de su tramo del archivo
+//   de entrada (enteros de 32 bits) y con todas ellas se eligen size - 1
+//   separadores, como en el sample sort.
+// Fase 2: en rondas, cada proceso lee un bloque del tamaño permitido por el
+//   presupuesto de memoria (lectura colectiva MPI-IO), lo ordena, lo parte
+//   por los separadores y un MPI_Alltoallv entrega a cada proceso su cubeta;
+//   la mezcla de lo recibido es una secuencia ordenada que se vuelca al
+//   disco local (scratch). Con claves sesgadas un proceso podría recibir
+//   hasta size bloques en una ronda: el máximo recibido se acuerda con un
+//   MPI_Allreduce y, si no cabe en un bloque, la ronda se parte en
+//   sub-rondas que envían a la vez un trozo proporcional de cada cubeta.
+// Fase 3: cada proceso mezcla sus secuencias con un árbol de perdedores. Cada
+//   secuencia se lee con dos búferes: mientras se consume uno, el otro se
+//   rellena con MPI_File_iread_at. La salida también usa dos búferes con
+//   MPI_File_iwrite_at en su desplazamiento del archivo de salida (MPI_Exscan
+//   de los tamaños de las cubetas), que queda ordenado globalmente.
+#define EXT_SAMPLES 256 // Muestras por proceso para elegir los separadores
+#define EXT_MIN_BLOCK 1024 // Tamaño mínimo de bloque (enteros)
+
+// Lector con doble búfer de una secuencia ordenada en disco
+typedef struct {
+  MPI_File file;
+  MPI_Offset next;      // Siguiente elemento a pedir
+  MPI_Offset remaining; // Elementos aún no pedidos
+  int *buf[2];
+  int len[2];
+  int capacity;
+  int active; // Búfer que se consume
+  int pos;    // Posición en buf[active]
+  int pending;
+  MPI_Request request; // Lectura en curso sobre buf[1 - active]
+} run_reader_t;
+
+static void run_reader_issue(run_reader_t *reader, int b) {
+  int len = reader->remaining < reader->capacity ? (int)reader->remaining
+                                                 : reader->capacity;
+  reader->len[b] = len;
+  reader->pending = len > 0;
+  if (len > 0) {
+    MPI_File_iread_at(reader->file, reader->next * (MPI_Offset)sizeof(int),
+                      reader->buf[b], len, MPI_INT, &reader->request);
+    reader->next += len;
+    reader->remaining -= len;
+  }
+}
+
+// Pasa al otro búfer (esperando su lectura) y pide el siguiente bloque.
+// Devuelve 0 si la secuencia se ha agotado.
+static int run_reader_advance(run_reader_t *reader) {
+  if (reader->pending)
+    MPI_Wait(&reader->request, MPI_STATUS_IGNORE);
+  reader->pending = 0;
+  reader->active = 1 - reader->active;
+  reader->pos = 0;
+  if (reader->len[reader->active] == 0)
+    return 0;
+  run_reader_issue(reader, 1 - reader->active);
+  return 1;
+}
+
+// Escribe el bloque lleno de la salida y cambia de búfer
+static void flush_output(MPI_File fh, MPI_Offset *offset, int **out,
+                         int *out_len, int *active, MPI_Request *request) {
+  MPI_Wait(request, MPI_STATUS_IGNORE); // Escritura anterior (otro búfer)
+  MPI_File_iwrite_at(fh, *offset * (MPI_Offset)sizeof(int), out[*active],
+                     *out_len, MPI_INT, request);
+  *offset += *out_len;
+  *active = 1 - *active;
+  *out_len = 0;
+}
+
+void run_path(char *path, size_t length, const char *scratch_dir, int rank,
+              int run) {
+  snprintf(path, length, "%s/sort_run_%d_%d.bin", scratch_dir, rank, run);
+}
+
+// Devuelve 1 si la salida quedó ordenada y conserva todos los elementos
+int external_sort(const char *input_path, const char *output_path,
+                  long long int budget_bytes, const char *scratch_dir,
+                  int radix_bits, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  double phase_start = MPI_Wtime();
+
+  MPI_File in;
+  if (MPI_File_open(comm, input_path, MPI_MODE_RDONLY, MPI_INFO_NULL, &in) !=
+      MPI_SUCCESS) {
+    if (rank == 0)
+      fprintf(stderr, "No se pudo abrir %s\n", input_path);
+    MPI_Abort(comm, 1);
+  }
+  MPI_Offset file_size;
+  MPI_File_get_size(in, &file_size);
+  if (file_size % (MPI_Offset)sizeof(int) != 0) {
+    if (rank == 0)
+      fprintf(stderr, "%s: %lld bytes no es un múltiplo de %d (int)\n",
+              input_path, (long long int)file_size, (int)sizeof(int));
+    MPI_Abort(comm, 1);
+  }
+  long long int n = file_size / (MPI_Offset)sizeof(int);
+  long long int slice_first = n * rank / size;
+  long long int slice_count = n * (rank + 1) / size - slice_first;
+
+  // El bloque leído, lo recibido y su mezcla deben caber en el presupuesto;
+  // radix sort usa como auxiliar el búfer de recepción, libre mientras
+  // ordena el bloque, así que no hace falta un cuarto búfer
+  long long int block = budget_bytes / (3 * (long long int)sizeof(int));
+  if (block < EXT_MIN_BLOCK)
+    block = EXT_MIN_BLOCK;
+  if (block > INT_MAX / 2)
+    block = INT_MAX / 2;
+
+  // ========== FASE 1: SEPARADORES POR MUESTREO ==========
+  int *samples = malloc(EXT_SAMPLES * sizeof(int));
+  for (int i = 0; i < EXT_SAMPLES; i++) {
+    samples[i] = INT_MAX;
+    if (slice_count > 0) {
+      MPI_Offset index = slice_first + slice_count * i / EXT_SAMPLES;
+      MPI_File_read_at(in, index * (MPI_Offset)sizeof(int), &samples[i], 1,
+                       MPI_INT, MPI_STATUS_IGNORE);
+    }
+  }
+  int *all_samples = malloc(size * EXT_SAMPLES * sizeof(int));
+  MPI_Allgather(samples, EXT_SAMPLES, MPI_INT, all_samples, EXT_SAMPLES,
+                MPI_INT, comm);
+  quicksort(all_samples, 0, size * EXT_SAMPLES - 1);
+  int *splitters = malloc((size > 1 ? size - 1 : 1) * sizeof(int));
+  for (int i = 1; i < size; i++)
+    splitters[i - 1] = all_samples[i * EXT_SAMPLES];
+  free(samples);
+  free(all_samples);
+
+  // ========== FASE 2: SECUENCIAS ORDENADAS AL DISCO LOCAL ==========
+  long long int local_rounds = (slice_count + block - 1) / block, rounds;
+  MPI_Allreduce(&local_rounds, &rounds, 1, MPI_LONG_LONG_INT, MPI_MAX, comm);
+
+  // Una sub-ronda reparte floor(c (j + 1) / k) - floor(c j / k) elementos
+  // de cada cubeta de c elementos, así un proceso recibe como mucho
+  // total / k + size: con k = ceil(máximo / sub_capacity) cabe en un bloque
+  long long int sub_capacity = block - size > 0 ? block - size : 1;
+  int *chunk = malloc(block * sizeof(int));
+  int *received = malloc(block * sizeof(int));
+  int *run = malloc(block * sizeof(int));
+  long long int *send_counts = malloc(size * sizeof(long long int));
+  long long int *send_displs = malloc(size * sizeof(long long int));
+  long long int *recv_counts = malloc(size * sizeof(long long int));
+  long long int *sub_counts = malloc(4 * size * sizeof(long long int));
+  long long int *sub_send_counts = sub_counts;
+  long long int *sub_send_displs = sub_counts + size;
+  long long int *sub_recv_counts = sub_counts + 2 * size;
+  long long int *sub_recv_displs = sub_counts + 3 * size;
+  long long int run_slots = rounds > 0 ? rounds : 1;
+  long long int *run_lengths = malloc(run_slots * sizeof(long long int));
+  int runs = 0;
+  long long int exchanges = 0;
+  long long int local_checksum = 0, checksum;
+
+  for (long long int r = 0; r < rounds; r++) {
+    long long int offset = r * block;
+    int len = 0;
+    if (offset < slice_count)
+      len = (int)(slice_count - offset < block ? slice_count - offset : block);
+    MPI_File_read_at_all(in, (slice_first + offset) * (MPI_Offset)sizeof(int),
+                         chunk, len, MPI_INT, MPI_STATUS_IGNORE);
+    for (int i = 0; i < len; i++)
+      local_checksum += chunk[i];
+    local_sort(chunk, len, radix_bits, received);
+
+    partition_by_splitters(chunk, len, splitters, size, send_counts,
+                           send_displs);
+    MPI_Alltoall(send_counts, 1, MPI_LONG_LONG_INT, recv_counts, 1,
+                 MPI_LONG_LONG_INT, comm);
+    long long int total = 0, max_total;
+    for (int p = 0; p < size; p++)
+      total += recv_counts[p];
+    MPI_Allreduce(&total, &max_total, 1, MPI_LONG_LONG_INT, MPI_MAX, comm);
+    long long int sub_rounds =
+        max_total <= block ? (max_total > 0)
+                           : (max_total + sub_capacity - 1) / sub_capacity;
+    exchanges += sub_rounds;
+
+    for (long long int j = 0; j < sub_rounds; j++) {
+      long long int got = 0;
+      for (int p = 0; p < size; p++) {
+        long long int sent = send_counts[p] * j / sub_rounds;
+        sub_send_counts[p] = send_counts[p] * (j + 1) / sub_rounds - sent;
+        sub_send_displs[p] = send_displs[p] + sent;
+        long long int recv = recv_counts[p] * j / sub_rounds;
+        sub_recv_counts[p] = recv_counts[p] * (j + 1) / sub_rounds - recv;
+        sub_recv_displs[p] = got;
+        got += sub_recv_counts[p];
+      }
+      alltoallv_large(chunk, sub_send_counts, sub_send_displs, received,
+                      sub_recv_counts, sub_recv_displs, MPI_INT, comm);
+      if (got == 0)
+        continue;
+      kway_merge(received, sub_recv_displs, sub_recv_counts, size, run);
+
+      char path[4096];
+      run_path(path, sizeof(path), scratch_dir, rank, runs);
+      MPI_File fh;
+      if (MPI_File_open(MPI_COMM_SELF, path,
+                        MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                        &fh) != MPI_SUCCESS) {
+        fprintf(stderr, "Proceso %d: no se pudo crear %s\n", rank, path);
+        MPI_Abort(comm, 1);
+      }
+      MPI_File_set_size(fh, 0);
+      for (long long int off = 0; off < got; off += EXCHANGE_CHUNK) {
+        int len = got - off < EXCHANGE_CHUNK ? got - off : EXCHANGE_CHUNK;
+        MPI_File_write_at(fh, off * (MPI_Offset)sizeof(int), run + off, len,
+                          MPI_INT, MPI_STATUS_IGNORE);
+      }
+      MPI_File_close(&fh);
+      if (runs == run_slots) {
+        run_slots *= 2;
+        run_lengths = realloc(run_lengths, run_slots * sizeof(long long int));
+      }
+      run_lengths[runs++] = got;
+    }
+  }
+  MPI_File_close(&in);
+  free(chunk);
+  free(received);
+  free(run);
+  free(send_counts);
+  free(send_displs);
+  free(recv_counts);
+  free(sub_counts);
+  free(splitters);
+  MPI_Allreduce(&local_checksum, &checksum, 1, MPI_LONG_LONG_INT, MPI_SUM,
+                comm);
+  double run_time = MPI_Wtime() - phase_start;
+  phase_start = MPI_Wtime();
+
+  // ========== FASE 3: MEZCLA CON ÁRBOL DE PERDEDORES ==========
+  long long int my_total = 0, my_offset = 0;
+  for (int i = 0; i < runs; i++)
+    my_total += run_lengths[i];
+  MPI_Exscan(&my_total, &my_offset, 1, MPI_LONG_LONG_INT, MPI_SUM, comm);
+  if (rank == 0)
+    my_offset = 0;
+
+  MPI_File out;
+  if (MPI_File_open(comm, output_path, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                    MPI_INFO_NULL, &out) != MPI_SUCCESS) {
+    if (rank == 0)
+      fprintf(stderr, "No se pudo crear %s\n", output_path);
+    MPI_Abort(comm, 1);
+  }
+  MPI_File_set_size(out, n * (MPI_Offset)sizeof(int));
+
+  // Dos búferes por secuencia y dos de salida dentro del presupuesto
+  long long int buffer_len = budget_bytes /
+                             (2 * (long long int)sizeof(int) * (runs + 1));
+  if (buffer_len < EXT_MIN_BLOCK)
+    buffer_len = EXT_MIN_BLOCK;
+  if (buffer_len > block)
+    buffer_len = block;
+
+  run_reader_t *readers = malloc((runs > 0 ? runs : 1) * sizeof(run_reader_t));
+  long long *keys = malloc((runs > 0 ? runs : 1) * sizeof(long long));
+  for (int i = 0; i < runs; i++) {
+    char path[4096];
+    run_path(path, sizeof(path), scratch_dir, rank, i);
+    run_reader_t *reader = &readers[i];
+    MPI_File_open(MPI_COMM_SELF, path,
+                  MPI_MODE_RDONLY | MPI_MODE_DELETE_ON_CLOSE, MPI_INFO_NULL,
+                  &reader->file);
+    reader->next = 0;
+    reader->remaining = run_lengths[i];
+    reader->capacity = (int)buffer_len;
+    reader->buf[0] = malloc(buffer_len * sizeof(int));
+    reader->buf[1] = malloc(buffer_len * sizeof(int));
+    reader->active = 1;
+    reader->len[1] = 0;
+    run_reader_issue(reader, 0);
+    run_reader_advance(reader);
+    keys[i] = reader->buf[0][0];
+  }
+
+  int *out_buf[2];
+  out_buf[0] = malloc(buffer_len * sizeof(int));
+  out_buf[1] = malloc(buffer_len * sizeof(int));
+  int out_len = 0, out_active = 0;
+  MPI_Request write_request = MPI_REQUEST_NULL;
+  MPI_Offset out_offset = my_offset;
+
+  // Resumen para la verificación, calculado al escribir
+  int ok = 1, first = 0, last = INT_MIN;
+  long long int written = 0, local_sum = 0;
+
+  if (runs > 0) {
+    loser_tree_t tree;
+    loser_tree_init(&tree, keys, runs);
+    while (keys[tree.node[0]] != LLONG_MAX) {
+      int w = tree.node[0];
+      int value = (int)keys[w];
+      if (written == 0)
+        first = value;
+      ok &= value >= last;
+      last = value;
+      local_sum += value;
+      written++;
+
+      out_buf[out_active][out_len++] = value;
+      if (out_len == buffer_len)
+        flush_output(out, &out_offset, out_buf, &out_len, &out_active,
+                     &write_request);
+
+      run_reader_t *reader = &readers[w];
+      if (++reader->pos < reader->len[reader->active] ||
+          run_reader_advance(reader))
+        keys[w] = reader->buf[reader->active][reader->pos];
+      else
+        keys[w] = LLONG_MAX;
+      loser_tree_replay(&tree);
+    }
+    loser_tree_free(&tree);
+  }
+  if (out_len > 0)
+    flush_output(out, &out_offset, out_buf, &out_len, &out_active,
+                 &write_request);
+  MPI_Wait(&write_request, MPI_STATUS_IGNORE);
+  MPI_File_close(&out);
+
+  for (int i = 0; i < runs; i++) {
+    MPI_File_close(&readers[i].file); // Borra la secuencia del scratch
+    free(readers[i].buf[0]);
+    free(readers[i].buf[1]);
+  }
+  free(readers);
+  free(keys);
+  free(out_buf[0]);
+  free(out_buf[1]);
+  free(run_lengths);
+  double merge_time = MPI_Wtime() - phase_start;
+
+  int correct = verify_summary(ok, first, last, written, local_sum, n,
+                               checksum, comm);
+
+  int total_runs;
+  MPI_Reduce(&runs, &total_runs, 1, MPI_INT, MPI_SUM, 0, comm);
+  if (rank == 0) {
+    printf("=== ORDENACIÓN EXTERNA ===\n");
+    printf("Entrada: %s (%lld enteros), salida: %s\n", input_path, n,
+           output_path);
+    printf("Presupuesto: %lld MiB/proceso, bloque: %lld enteros, "
+           "%lld rondas, %lld intercambios\n",
+           budget_bytes >> 20, block, rounds, exchanges);
+    printf("Secuencias en scratch (%s): %d en total\n", scratch_dir,
+           total_runs);
+    printf("Fase de secuencias: %.6f segundos\n", run_time);
+    printf("Fase de mezcla:     %.6f segundos\n", merge_time);
+  }
+  return correct;
+}
+
+// ========== REGISTROS DE ANCHO FIJO ==========
+// Registros de record_size bytes con una clave de tipo key_type en
+// key_offset (el resto es carga útil). Las claves se comparan convertidas a
+// un entero sin signo de 64 bits con el mismo orden (bit de signo invertido
+// en enteros, truco IEEE en double). Un comparador opcional sustituye a la
+// clave. Entre procesos los registros viajan como un tipo derivado
+// contiguo de record_size bytes: MPI_Alltoallv envía directamente desde el
+// búfer ordenado, sin empaquetar.
+typedef enum { KEY_INT32, KEY_UINT32, KEY_INT64, KEY_DOUBLE } key_type_t;
+
+typedef int (*record_cmp_t)(const void *a, const void *b);
+
+typedef struct {
+  int record_size;
+  int key_offset;
+  key_type_t key_type;
+  record_cmp_t compare; // NULL: ordenar por la clave
+  MPI_Datatype type;    // record_size bytes contiguos
+} record_layout_t;
+
+int key_width(key_type_t key_type) {
+  return key_type == KEY_INT32 || key_type == KEY_UINT32 ? 4 : 8;
+}
+
+// Clave normalizada: el orden sin signo coincide con el del tipo original
+uint64_t record_key(const record_layout_t *layout, const char *record) {
+  const char *field = record + layout->key_offset;
+  switch (layout->key_type) {
+  case KEY_INT32: {
+    uint32_t v;
+    memcpy(&v, field, sizeof(v));
+    return v ^ 0x80000000u;
+  }
+  case KEY_UINT32: {
+    uint32_t v;
+    memcpy(&v, field, sizeof(v));
+    return v;
+  }
+  case KEY_INT64: {
+    uint64_t v;
+    memcpy(&v, field, sizeof(v));
+    return v ^ (1ULL << 63);
+  }
+  default: { // KEY_DOUBLE: negativos invertidos, positivos con el signo a 1
+    uint64_t v;
+    memcpy(&v, field, sizeof(v));
+    return (v >> 63) ? ~v : v | (1ULL << 63);
+  }
+  }
+}
+
+int record_compare(const record_layout_t *layout, const char *a,
+                   const char *b) {
+  if (layout->compare != NULL)
+    return layout->compare(a, b);
+  uint64_t ka = record_key(layout, a), kb = record_key(layout, b);
+  return (ka > kb) - (ka < kb);
+}
+
+// QuickSort de registros en su sitio (mismo esquema que quicksort());
+// pivot y swap son búferes de record_size bytes
+void record_quicksort(char *base, long long int lo, long long int hi,
+                      const record_layout_t *layout, char *pivot,
+                      char *swap) {
+  if (lo >= hi)
+    return;
+  size_t rs = layout->record_size;
+  memcpy(pivot, base + ((lo + hi) / 2) * rs, rs);
+  long long int i = lo, j = hi;
+  while (i <= j) {
+    while (record_compare(layout, base + i * rs, pivot) < 0)
+      i++;
+    while (record_compare(layout, base + j * rs, pivot) > 0)
+      j--;
+    if (i <= j) {
+      memcpy(swap, base + i * rs, rs);
+      memcpy(base + i * rs, base + j * rs, rs);
+      memcpy(base + j * rs, swap, rs);
+      i++;
+      j--;
+    }
+  }
+  record_quicksort(base, lo, j, layout, pivot, swap);
+  record_quicksort(base, i, hi, layout, pivot, swap);
+}
+
+// Pares (clave, índice): se ordenan los pares y los registros se mueven una
+// sola vez al final. Conviene cuando la carga útil es grande.
+typedef struct {
+  uint64_t key;
+  long long int index;
+} key_index_t;
+
+// Radix sort LSD de los pares por su clave de 64 bits (dígitos de 11 bits),
+// saltando las pasadas de dígito constante como radix_sort(): con claves
+// de 32 bits solo se hacen 3 de las 6 pasadas
+void radix_sort_pairs(key_index_t *pairs, long long int n) {
+  enum { BITS = 11, BUCKETS = 1 << 11, PASSES = 6 };
+  if (n < 2)
+    return;
+  key_index_t *tmp = malloc(n * sizeof(key_index_t));
+  long long int *hist = calloc(PASSES * BUCKETS, sizeof(long long int));
+  for (long long int i = 0; i < n; i++)
+    for (int p = 0; p < PASSES; p++)
+      hist[p * BUCKETS + ((pairs[i].key >> (p * BITS)) & (BUCKETS - 1))]++;
+
+  key_index_t *src = pairs, *dst = tmp;
+  for (int p = 0; p < PASSES; p++) {
+    long long int *h = hist + p * BUCKETS;
+    int shift = p * BITS;
+    if (h[(src[0].key >> shift) & (BUCKETS - 1)] == n)
+      continue; // Dígito constante
+    long long int sum = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+      long long int count = h[b];
+      h[b] = sum;
+      sum += count;
+    }
+    for (long long int i = 0; i < n; i++)
+      dst[h[(src[i].key >> shift) & (BUCKETS - 1)]++] = src[i];
+    key_index_t *swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if (src != pairs)
+    memcpy(pairs, src, n * sizeof(key_index_t));
+  free(tmp);
+  free(hist);
+}
+
+// Ordenación local de registros: por pares (clave, índice) o en su sitio.
+// Con comparador no hay clave que extraer y se ordena en su sitio.
+void record_local_sort(char *records, long long int count,
+                       const record_layout_t *layout, int use_pairs) {
+  size_t rs = layout->record_size;
+  if (count < 2)
+    return;
+  if (use_pairs && layout->compare == NULL) {
+    key_index_t *pairs = malloc(count * sizeof(key_index_t));
+    for (long long int i = 0; i < count; i++) {
+      pairs[i].key = record_key(layout, records + i * rs);
+      pairs[i].index = i;
+    }
+    radix_sort_pairs(pairs, count);
+    char *sorted = malloc(count * rs);
+    for (long long int i = 0; i < count; i++)
+      memcpy(sorted + i * rs, records + pairs[i].index * rs, rs);
+    memcpy(records, sorted, count * rs);
+    free(sorted);
+    free(pairs);
+  } else {
+    char *pivot = malloc(rs), *swap = malloc(rs);
+    record_quicksort(records, 0, count - 1, layout, pivot, swap);
+    free(pivot);
+    free(swap);
+  }
+}
+
+// Mezcla k listas de registros con un árbol de perdedores sobre punteros a
+// la cabeza de cada lista (NULL = agotada)
+static int record_head_less(const record_layout_t *layout, const char *a,
+                            const char *b) {
+  if (a == NULL)
+    return 0;
+  if (b == NULL)
+    return 1;
+  return record_compare(layout, a, b) < 0;
+}
+
+void record_kway_merge(const char *data, const long long int *starts,
+                       const long long int *counts, int k,
+                       const record_layout_t *layout, char *result) {
+  size_t rs = layout->record_size;
+  const char **head = malloc((k > 0 ? k : 1) * sizeof(char *));
+  long long int *left = malloc((k > 0 ? k : 1) * sizeof(long long int));
+  int *node = malloc((k > 0 ? k : 1) * sizeof(int));
+  int *winner = malloc(2 * (k > 0 ? k : 1) * sizeof(int));
+  long long int total = 0;
+  for (int r = 0; r < k; r++) {
+    head[r] = counts[r] > 0 ? data + (size_t)starts[r] * rs : NULL;
+    left[r] = counts[r];
+    total += counts[r];
+    winner[k + r] = r;
+  }
+  for (int n = k - 1; n > 0; n--) {
+    int a = winner[2 * n], b = winner[2 * n + 1];
+    int a_wins = !record_head_less(layout, head[b], head[a]);
+    winner[n] = a_wins ? a : b;
+    node[n] = a_wins ? b : a;
+  }
+  node[0] = k > 1 ? winner[1] : 0;
+
+  for (long long int out = 0; out < total; out++) {
+    int w = node[0];
+    memcpy(result + out * rs, head[w], rs);
+    head[w] = --left[w] > 0 ? head[w] + rs : NULL;
+    for (int n = (w + k) / 2; n > 0; n /= 2) {
+      int l = node[n];
+      if (record_head_less(layout, head[l], head[w])) {
+        node[n] = w;
+        w = l;
+      }
+    }
+    node[0] = w;
+  }
+
+  free(head);
+  free(left);
+  free(node);
+  free(winner);
+}
+
+// Sample sort (PSRS) de registros: mismo esquema que sample_sort(), con
+// muestras y separadores que son registros completos. Devuelve el búfer
+// local ordenado (nuevo) y su número de registros en out_count.
+char *record_sample_sort(char *records, long long int count,
+                         long long int *out_count,
+                         const record_layout_t *layout, int use_pairs,
+                         MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  size_t rs = layout->record_size;
+
+  record_local_sort(records, count, layout, use_pairs);
+
+  // Muestras regulares; un proceso sin registros no aporta muestras
+  char *samples = calloc(size, rs);
+  for (int i = 0; i < size && count > 0; i++)
+    memcpy(samples + i * rs, records + ((long long int)i * count / size) * rs,
+           rs);
+  int *sample_counts = malloc(size * sizeof(int));
+  int *sample_displs = malloc(size * sizeof(int));
+  int sample_count = count > 0 ? size : 0;
+  MPI_Gather(&sample_count, 1, MPI_INT, sample_counts, 1, MPI_INT, 0, comm);
+  int total_samples = 0;
+  if (rank == 0)
+    for (int r = 0; r < size; r++) {
+      sample_displs[r] = total_samples;
+      total_samples += sample_counts[r];
+    }
+  char *all_samples = rank == 0 ? malloc((size * size) * rs + 1) : NULL;
+  MPI_Gatherv(samples, sample_count, layout->type, all_samples, sample_counts,
+              sample_displs, layout->type, 0, comm);
+
+  char *splitters = calloc(size > 1 ? size - 1 : 1, rs);
+  if (rank == 0 && total_samples > 0) {
+    record_local_sort(all_samples, total_samples, layout, 0);
+    for (int i = 1; i < size; i++)
+      memcpy(splitters + (i - 1) * rs,
+             all_samples + ((long long int)i * total_samples / size) * rs,
+             rs);
+  }
+  free(all_samples);
+  MPI_Bcast(splitters, size - 1, layout->type, 0, comm);
+
+  // Cubeta r: registros <= splitters[r] (búsqueda binaria)
+  long long int *send_counts = malloc(size * sizeof(long long int));
+  long long int *send_displs = malloc(size * sizeof(long long int));
+  long long int start = 0;
+  for (int r = 0; r < size; r++) {
+    long long int end = count;
+    if (r < size - 1) {
+      long long int lo = start, hi = count;
+      while (lo < hi) {
+        long long int mid = lo + (hi - lo) / 2;
+        if (record_compare(layout, records + mid * rs, splitters + r * rs) <=
+            0)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      end = lo;
+    }
+    send_displs[r] = start;
+    send_counts[r] = end - start;
+    start = end;
+  }
+
+  long long int *recv_counts = malloc(size * sizeof(long long int));
+  long long int *recv_displs = malloc(size * sizeof(long long int));
+  MPI_Alltoall(send_counts, 1, MPI_LONG_LONG_INT, recv_counts, 1,
+               MPI_LONG_LONG_INT, comm);
+  long long int total = 0;
+  for (int r = 0; r < size; r++) {
+    recv_displs[r] = total;
+    total += recv_counts[r];
+  }
+
+  // Cuentas y desplazamientos en registros: el tipo derivado hace el resto
+  // (en bloques si alguna cuenta no cabe en int)
+  char *received = malloc((total > 0 ? total : 1) * rs);
+  alltoallv_large(records, send_counts, send_displs, received, recv_counts,
+                  recv_displs, layout->type, comm);
+
+  char *result = malloc((total > 0 ? total : 1) * rs);
+  record_kway_merge(received, recv_displs, recv_counts, size, layout, result);
+
+  free(samples);
+  free(sample_counts);
+  free(sample_displs);
+  free(splitters);
+  free(send_counts);
+  free(send_displs);
+  free(recv_counts);
+  free(recv_displs);
+  free(received);
+
+  *out_count = total;
+  return result;
+}
+
+// Comparador de ejemplo (-C): orden descendente de una clave int32 en el
+// desplazamiento 0
+int compare_int32_desc(const void *a, const void *b) {
+  int32_t x, y;
+  memcpy(&x, a, sizeof(x));
+  memcpy(&y, b, sizeof(y));
+  return (x < y) - (x > y);
+}
+
+// Carga útil derivada de la clave para comprobar que los registros viajan
+// completos
+static unsigned char payload_byte(uint64_t key, int i) {
+  return (unsigned char)(key * 0x9E3779B97F4A7C15ULL >> 56) + (unsigned char)i;
+}
+
+// Genera count registros aleatorios en cada proceso, los ordena y verifica:
+// orden local y entre procesos, registros intactos y suma de claves
+int run_record_sort(long long int n, long long int count,
+                    const record_layout_t *layout, int use_pairs,
+                    MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  size_t rs = layout->record_size;
+  int width = key_width(layout->key_type);
+
+  char *records = malloc((count > 0 ? count : 1) * rs);
+  srand(time(NULL) + rank);
+  uint64_t local_keysum = 0;
+  for (long long int i = 0; i < count; i++) {
+    char *record = records + i * rs;
+    uint64_t bits = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^
+                    (uint64_t)rand();
+    if (layout->key_type == KEY_DOUBLE) {
+      double v = ((double)rand() / RAND_MAX - 0.5) * 2e6;
+      memcpy(record + layout->key_offset, &v, sizeof(v));
+    } else {
+      memcpy(record + layout->key_offset, &bits, width); // little endian
+    }
+    uint64_t key = record_key(layout, record);
+    for (int j = 0; j < (int)rs; j++)
+      if (j < layout->key_offset || j >= layout->key_offset + width)
+        record[j] = payload_byte(key, j);
+    local_keysum += key;
+  }
+
+  MPI_Barrier(comm);
+  double start = MPI_Wtime();
+  long long int sorted_count;
+  char *sorted = record_sample_sort(records, count, &sorted_count, layout,
+                                    use_pairs, comm);
+  double elapsed = MPI_Wtime() - start;
+
+  // Orden local, integridad de la carga útil y suma de claves
+  int ok = 1;
+  uint64_t sorted_keysum = 0;
+  for (long long int i = 0; i < sorted_count; i++) {
+    const char *record = sorted + i * rs;
+    if (i > 0 && record_compare(layout, record - rs, record) > 0)
+      ok = 0;
+    uint64_t key = record_key(layout, record);
+    for (int j = 0; j < (int)rs; j++)
+      if ((j < layout->key_offset || j >= layout->key_offset + width) &&
+          (unsigned char)record[j] != payload_byte(key, j))
+        ok = 0;
+    sorted_keysum += key;
+  }
+
+  // Orden entre procesos: primer y último registro de cada proceso
+  char *ends = calloc(2, rs);
+  if (sorted_count > 0) {
+    memcpy(ends, sorted, rs);
+    memcpy(ends + rs, sorted + (sorted_count - 1) * rs, rs);
+  }
+  char *all_ends = malloc(2 * size * rs);
+  long long int *all_counts = malloc(size * sizeof(long long int));
+  MPI_Allgather(ends, 2, layout->type, all_ends, 2, layout->type, comm);
+  MPI_Allgather(&sorted_count, 1, MPI_LONG_LONG_INT, all_counts, 1,
+                MPI_LONG_LONG_INT, comm);
+  const char *previous_last = NULL;
+  for (int r = 0; r < size; r++) {
+    if (all_counts[r] == 0)
+      continue;
+    if (previous_last != NULL &&
+        record_compare(layout, previous_last, all_ends + 2 * r * rs) > 0)
+      ok = 0;
+    previous_last = all_ends + (2 * r + 1) * rs;
+  }
+
+  uint64_t sums[2] = {local_keysum, sorted_keysum}, total_sums[2];
+  long long int local_total = sorted_count, total;
+  int all_ok;
+  MPI_Allreduce(sums, total_sums, 2, MPI_UINT64_T, MPI_SUM, comm);
+  MPI_Allreduce(&local_total, &total, 1, MPI_LONG_LONG_INT, MPI_SUM, comm);
+  MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+  all_ok = all_ok && total == n && total_sums[0] == total_sums[1];
+
+  if (sorted_count > 0)
+    printf("Proceso %d: %lld registros\n", rank, sorted_count);
+  if (rank == 0) {
+    const char *names[] = {"i32", "u32", "i64", "f64"};
+    printf("\nRegistros de %d bytes, clave %s en el byte %d%s, %s\n",
+           layout->record_size, names[layout->key_type], layout->key_offset,
+           layout->compare != NULL ? " (comparador)" : "",
+           use_pairs && layout->compare == NULL ? "pares (clave, índice)"
+                                                : "en su sitio");
+    printf("Sample sort de registros: %.6f segundos\n", elapsed);
+  }
+
+  free(records);
+  free(sorted);
+  free(ends);
+  free(all_ends);
+  free(all_counts);
+  return all_ok;
+}
+
+// ========== ESCALADO DÉBIL ==========
+// Sample sort con per_rank claves por proceso (rango completo de int) con
+// 1, 2, 4, ... y finalmente size procesos (MPI_Comm_split): el total crece
+// con los procesos y, con escalado ideal, el tiempo no cambia. Las claves
+// se generan con splitmix64 (rand() sería el cuello de botella con miles de
+// millones de claves). El tiempo incluye la ordenación local.
+static uint64_t splitmix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void benchmark_weak_scaling(long long int per_rank, int radix_bits,
+                            MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  if (rank == 0) {
+    printf("=== ESCALADO DÉBIL DEL SAMPLE SORT ===\n");
+    printf("%lld claves/proceso, ordenación local: %s\n", per_rank,
+           radix_bits > 0 ? "radix sort" : "quicksort");
+    printf("%6s %16s %12s %12s %10s\n", "procs", "claves", "tiempo (s)",
+           "Mclaves/s", "eficiencia");
+  }
+
+  double base_time = 0;
+  for (int p = 1;; p = p * 2 < size ? p * 2 : size) {
+    MPI_Comm sub;
+    MPI_Comm_split(comm, rank < p ? 0 : MPI_UNDEFINED, rank, &sub);
+    if (sub != MPI_COMM_NULL) {
+      int *data = malloc((per_rank > 0 ? per_rank : 1) * sizeof(int));
+      uint64_t state = 0x5EED0000ULL + rank;
+      long long int local_sum = 0, checksum;
+      for (long long int i = 0; i < per_rank; i++) {
+        data[i] = (int)(splitmix64(&state) >> 32);
+        local_sum += data[i];
+      }
+      MPI_Allreduce(&local_sum, &checksum, 1, MPI_LONG_LONG_INT, MPI_SUM,
+                    sub);
+
+      MPI_Barrier(sub);
+      double start = MPI_Wtime();
+      local_sort(data, per_rank, radix_bits, NULL);
+      long long int sorted_size;
+      int *sorted = sample_sort(data, per_rank, &sorted_size, sub);
+      double elapsed = MPI_Wtime() - start, max_elapsed;
+      MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, sub);
+      int ok = verify_distributed(sorted, sorted_size, per_rank * p, checksum,
+                                  sub);
+
+      if (rank == 0) {
+        if (p == 1)
+          base_time = max_elapsed;
+        printf("%6d %16lld %12.4f %12.1f %9.1f%% %s\n", p, per_rank * p,
+               max_elapsed, per_rank * p / max_elapsed / 1e6,
+               100.0 * base_time / max_elapsed, ok ? "✅" : "❌");
+      }
+      free(data);
+      free(sorted);
+      MPI_Comm_free(&sub);
+    }
+    if (p == size)
+      break;
+  }
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // ========== CONFIGURACIÓN ==========
+  // Uso: ./merge [-a tree|sample] [-m kway|pairwise] [-k quick|radix]
+  //              [-b 8|11] [-B] [n]
+  //       ./merge -W claves_por_proceso [-k quick|radix]
+  //       ./merge -x entrada [-o salida] [-M MiB] [-d scratch] [-k ...]
+  //       ./merge -r bytes [-K desplazamiento] [-y i32|u32|i64|f64]
+  //               [-s pairs|inplace] [-C] [n]
+  //  tree:   mezcla por parejas en árbol binario hacia el proceso 0
+  //  sample: sample sort (PSRS), el resultado queda repartido
+  //  -m: en el árbol, mezclar por parejas en cada nivel (pairwise) o solo
+  //      reunir las listas y mezclarlas en el proceso 0 en una pasada (kway)
+  //  -k: ordenación local (quicksort o radix sort LSD de -b bits por pasada)
+  //  -B: benchmark de la ordenación local y de la mezcla de dos listas en
+  //      el proceso 0 hasta n elementos
+  //  -W: escalado débil del sample sort con claves_por_proceso claves
+  //  n admite valores de 64 bits y no tiene que ser múltiplo de procesos
+  //  -x: ordenación externa de un archivo binario de int con un presupuesto
+  //      de -M MiB por proceso y secuencias temporales en -d
+  //  -r: sample sort de n registros de -r bytes con clave -y en el byte -K;
+  //      ordenación local por pares (clave, índice) o en su sitio (-s);
+  //      -C usa un comparador de ejemplo (clave i32 en el byte 0, descendente)
+  int use_sample_sort = 0;
+  int pairwise_merge = 0;
+  int use_radix = 0, radix_bits = 11;
+  int benchmark = 0;
+  long long int weak_per_rank = 0;
+  const char *external_input = NULL, *external_output = "sorted.bin";
+  const char *scratch_dir = "/tmp";
+  long long int budget_mib = 64;
+  record_layout_t layout = {0, 0, KEY_INT32, NULL, MPI_DATATYPE_NULL};
+  int record_pairs = 1;
+  int opt, bad_args = 0;
+  while ((opt = getopt(argc, argv, "a:m:k:b:BW:x:o:M:d:r:K:y:s:C")) != -1) {
+    switch (opt) {
+    case 'a':
+      if (strcmp(optarg, "sample") == 0)
+        use_sample_sort = 1;
+      else if (strcmp(optarg, "tree") != 0)
+        bad_args = 1;
+      break;
+    case 'm':
+      if (strcmp(optarg, "pairwise") == 0)
+        pairwise_merge = 1;
+      else if (strcmp(optarg, "kway") != 0)
+        bad_args = 1;
+      break;
+    case 'k':
+      if (strcmp(optarg, "radix") == 0)
+        use_radix = 1;
+      else if (strcmp(optarg, "quick") != 0)
+        bad_args = 1;
+      break;
+    case 'b':
+      radix_bits = atoi(optarg);
+      if (radix_bits != 8 && radix_bits != 11)
+        bad_args = 1;
+      break;
+    case 'B':
+      benchmark = 1;
+      break;
+    case 'W':
+      weak_per_rank = atoll(optarg);
+      if (weak_per_rank <= 0)
+        bad_args = 1;
+      break;
+    case 'x':
+      external_input = optarg;
+      break;
+    case 'o':
+      external_output = optarg;
+      break;
+    case 'M':
+      budget_mib = atoll(optarg);
+      if (budget_mib <= 0)
+        bad_args = 1;
+      break;
+    case 'd':
+      scratch_dir = optarg;
+      break;
+    case 'r':
+      layout.record_size = atoi(optarg);
+      break;
+    case 'K':
+      layout.key_offset = atoi(optarg);
+      break;
+    case 'y':
+      if (strcmp(optarg, "i32") == 0)
+        layout.key_type = KEY_INT32;
+      else if (strcmp(optarg, "u32") == 0)
+        layout.key_type = KEY_UINT32;
+      else if (strcmp(optarg, "i64") == 0)
+        layout.key_type = KEY_INT64;
+      else if (strcmp(optarg, "f64") == 0)
+        layout.key_type = KEY_DOUBLE;
+      else
+        bad_args = 1;
+      break;
+    case 's':
+      if (strcmp(optarg, "inplace") == 0)
+        record_pairs = 0;
+      else if (strcmp(optarg, "pairs") != 0)
+        bad_args = 1;
+      break;
+    case 'C':
+      layout.compare = compare_int32_desc;
+      break;
+    default:
+      bad_args = 1;
+    }
+  }
+  // La clave debe caber en el registro; el comparador de ejemplo lee un
+  // int32 en el byte 0
+  if (layout.record_size != 0 &&
+      (layout.record_size < 0 || layout.key_offset < 0 ||
+       layout.key_offset + key_width(layout.key_type) > layout.record_size))
+    bad_args = 1;
+  if (layout.compare != NULL &&
+      (layout.key_type != KEY_INT32 || layout.key_offset != 0))
+    bad_args = 1;
+  if (bad_args) {
+    if (rank == 0)
+      fprintf(stderr,
+              "Uso: %s [-a tree|sample] [-m kway|pairwise] [-k quick|radix] "
+              "[-b 8|11] [-B] [n]\n"
+              "       %s -W claves_por_proceso [-k quick|radix]\n"
+              "       %s -x entrada [-o salida] [-M MiB] [-d scratch]\n"
+              "       %s -r bytes [-K desplazamiento] [-y i32|u32|i64|f64] "
+              "[-s pairs|inplace] [-C] [n]\n",
+              argv[0], argv[0], argv[0], argv[0]);
+    MPI_Finalize();
+    return 1;
+  }
+  if (!use_radix)
+    radix_bits = 0;
+
+  // ========== ORDENACIÓN EXTERNA ==========
+  if (external_input != NULL) {
+    int ok = external_sort(external_input, external_output, budget_mib << 20,
+                           scratch_dir, radix_bits, MPI_COMM_WORLD);
+    if (rank == 0)
+      printf("✅ Archivo de salida %sordenado correctamente\n",
+             ok ? "" : "NO ");
+    MPI_Finalize();
+    return 0;
+  }
+
+  long long int n = 32; // Total de elementos
+  if (optind < argc)
+    n = atoll(argv[optind]);
+
+  // ========== BENCHMARK DE ORDENACIÓN LOCAL ==========
+  if (benchmark) {
+    if (rank == 0) {
+      benchmark_local_sort(n < INT_MAX ? n : INT_MAX);
+      benchmark_merge(n < INT_MAX ? n : INT_MAX);
+    }
+    MPI_Finalize();
+    return 0;
+  }
+
+  // ========== ESCALADO DÉBIL ==========
+  if (weak_per_rank > 0) {
+    benchmark_weak_scaling(weak_per_rank, radix_bits, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return 0;
+  }
+
+  // ========== ORDENACIÓN DE REGISTROS ==========
+  if (layout.record_size > 0) {
+    MPI_Type_contiguous(layout.record_size, MPI_BYTE, &layout.type);
+    MPI_Type_commit(&layout.type);
+    long long int count =
+        block_start(n, size, rank + 1) - block_start(n, size, rank);
+    int ok = run_record_sort(n, count, &layout, record_pairs, MPI_COMM_WORLD);
+    if (rank == 0)
+      printf("✅ Registros %sordenados correctamente\n", ok ? "" : "NO ");
+    MPI_Type_free(&layout.type);
+    MPI_Finalize();
+    return 0;
+  }
+
+  // Reparto sin truncar: los n % size primeros procesos tienen un elemento
+  // más (block_start)
+  long long int local_first = block_start(n, size, rank);
+  long long int local_size = block_start(n, size, rank + 1) - local_first;
+  int *local_data = malloc((local_size > 0 ? local_size : 1) * sizeof(int));
+
+  // ========== GENERAR Y ORDENAR DATOS LOCALES ==========
+  srand(time(NULL) + rank); // Semilla diferente por proceso
+
+  for (long long int i = 0; i < local_size; i++) {
+    local_data[i] = rand() % 1000; // Números entre 0-999
+  }
+
+  // Ordenar localmente
+  double sort_start = MPI_Wtime();
+  local_sort(local_data, local_size, radix_bits, NULL);
+  double sort_time = MPI_Wtime() - sort_start, max_sort_time;
+  MPI_Reduce(&sort_time, &max_sort_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  // ========== PROCESO 0 MUESTRA LISTAS LOCALES ==========
+  if (rank == 0) {
+    printf("=== MERGE SORT PARALELO ===\n");
+    printf("Total elementos: %lld, Procesos: %d, Elementos/proceso: %lld",
+           n, size, n / size);
+    if (n % size != 0)
+      printf(" (+1 en los %lld primeros)", n % size);
+    printf("\n");
+    if (radix_bits > 0)
+      printf("Ordenación local: radix sort %d bits, %.6f segundos\n\n",
+             radix_bits, max_sort_time);
+    else
+      printf("Ordenación local: quicksort, %.6f segundos\n\n",
+             max_sort_time);
+  }
+
+  // Solo para tamaños pequeños: reunir todo en el proceso 0 es lo que el
+  // sample sort quiere evitar
+  if (n <= PRINT_MAX) {
+    // Recolectar y mostrar listas locales
+    int *all_local = NULL, *counts = NULL, *displs = NULL;
+    if (rank == 0) {
+      all_local = malloc((n > 0 ? n : 1) * sizeof(int));
+      counts = malloc(size * sizeof(int));
+      displs = malloc(size * sizeof(int));
+      for (int proc = 0; proc < size; proc++) {
+        displs[proc] = block_start(n, size, proc);
+        counts[proc] = block_start(n, size, proc + 1) - displs[proc];
+      }
+    }
+    MPI_Gatherv(local_data, local_size, MPI_INT, all_local, counts, displs,
+                MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+      printf("Listas locales ordenadas:\n");
+      for (int proc = 0; proc < size; proc++) {
+        printf("Proceso %d: [", proc);
+        for (int i = 0; i < counts[proc]; i++) {
+          printf("%d", all_local[displs[proc] + i]);
+          if (i < counts[proc] - 1)
+            printf(", ");
+        }
+        printf("]\n");
+      }
+      printf("\n");
+      free(all_local);
+      free(counts);
+      free(displs);
+    }
+  }
+
+  // ========== SAMPLE SORT (RESULTADO REPARTIDO) ==========
+  if (use_sample_sort) {
+    long long int local_sum = 0, checksum;
+    for (long long int i = 0; i < local_size; i++)
+      local_sum += local_data[i];
+    MPI_Allreduce(&local_sum, &checksum, 1, MPI_LONG_LONG_INT, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    long long int sorted_size;
+    int *sorted = sample_sort(local_data, local_size, &sorted_size,
+                              MPI_COMM_WORLD);
+    double elapsed = MPI_Wtime() - start;
+
+    int ok = verify_distributed(sorted, sorted_size, n, checksum,
+                                MPI_COMM_WORLD);
+
+    // Cada proceso informa su tramo (sin reunir los datos)
+    if (sorted_size > 0)
+      printf("Proceso %d: %lld elementos en [%d, %d]\n", rank, sorted_size,
+             sorted[0], sorted[sorted_size - 1]);
+    else
+      printf("Proceso %d: 0 elementos\n", rank);
+
+    if (rank == 0) {
+      printf("\nSample sort: %.6f segundos\n", elapsed);
+      printf("✅ Resultado repartido %sordenado correctamente\n",
+             ok ? "" : "NO ");
+    }
+
+    free(sorted);
+    free(local_data);
+    MPI_Finalize();
+    return 0;
+  }
+
+  // ========== MERGE SORT PARALELO (ÁRBOL BINARIO) ==========
+  // Cada proceso reúne como mucho su subárbol: los procesos
+  // [rank, rank + (rank & -rank)). Dos búferes de ese tamaño, reservados una
+  // sola vez, se alternan entre niveles: la lista actual está al principio
+  // de buffers[cur] y lo recibido se coloca detrás.
+  //  pairwise: en cada nivel se mezcla con lo recibido hacia el otro búfer,
+  //            solapando la mezcla con la recepción por bloques; los datos
+  //            se recorren log2(size) veces.
+  //  kway:     los niveles solo reúnen las listas (en orden de proceso) y el
+  //            proceso 0 las mezcla al final en una pasada con el árbol de
+  //            perdedores; el segundo búfer solo hace falta en el proceso 0.
+  int subtree = rank == 0 ? size : (rank & -rank);
+  if (rank + subtree > size)
+    subtree = size - rank;
+  long long int capacity =
+      block_start(n, size, rank + subtree) - block_start(n, size, rank);
+  int *buffers[2];
+  buffers[0] = malloc((capacity > 0 ? capacity : 1) * sizeof(int));
+  long long int second = pairwise_merge || rank == 0 ? capacity : 1;
+  buffers[1] = malloc((second > 0 ? second : 1) * sizeof(int));
+  MPI_Request *chunk_reqs =
+      malloc((capacity / MERGE_CHUNK + 1) * sizeof(MPI_Request));
+  memcpy(buffers[0], local_data, local_size * sizeof(int));
+
+  int cur = 0;
+  long long int current_size = local_size;
+  int step = 1;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double merge_start = MPI_Wtime();
+
+  while (step < size) {
+    int partner = rank ^ step; // Pareja usando XOR
+
+    if (partner < size) {
+      if (rank < partner) {
+        // El partner envía su subárbol: procesos [partner, partner + step)
+        int partner_end = size - partner < step ? size : partner + step;
+        long long int partner_size = block_start(n, size, partner_end) -
+                                     block_start(n, size, partner);
+
+        if (pairwise_merge) {
+          merge_pipelined(buffers[cur], current_size, partner_size, partner,
+                          chunk_reqs, buffers[1 - cur], MPI_COMM_WORLD);
+          cur = 1 - cur;
+        } else {
+          recv_chunked(buffers[cur] + current_size, partner_size, partner,
+                       chunk_reqs, MPI_COMM_WORLD);
+        }
+        current_size += partner_size;
+
+      } else {
+        // Enviar datos al partner y terminar
+        send_chunked(buffers[cur], current_size, partner, chunk_reqs,
+                     MPI_COMM_WORLD);
+        current_size = 0;
+        break;
+      }
+    }
+
+    step *= 2; // Siguiente nivel del árbol
+  }
+
+  // Mezcla única de las size listas reunidas en el proceso 0
+  if (!pairwise_merge && rank == 0 && size > 1) {
+    long long int *starts = malloc(size * sizeof(long long int));
+    long long int *counts = malloc(size * sizeof(long long int));
+    for (int r = 0; r < size; r++) {
+      starts[r] = block_start(n, size, r);
+      counts[r] = block_start(n, size, r + 1) - starts[r];
+    }
+    kway_merge(buffers[cur], starts, counts, size, buffers[1 - cur]);
+    cur = 1 - cur;
+    free(starts);
+    free(counts);
+  }
+  double merge_time = MPI_Wtime() - merge_start;
+  int *current_data = buffers[cur];
+
+  // ========== PROCESO 0 MUESTRA RESULTADO FINAL ==========
+  if (rank == 0) {
+    printf("Lista final ordenada (%lld elementos):\n[", current_size);
+    for (long long int i = 0; i < current_size && i < PRINT_MAX; i++) {
+      printf("%d", current_data[i]);
+      if (i < current_size - 1)
+        printf(", ");
+      if (i > 0 && i % 20 == 0)
+        printf("\n "); // Nueva línea cada 20 elementos
+    }
+    if (current_size > PRINT_MAX)
+      printf("...");
+    printf("]\n");
+
+    // Verificar que está ordenado y que no falta ningún elemento
+    int sorted = current_size == n;
+    for (long long int i = 1; i < current_size; i++) {
+      if (current_data[i] < current_data[i - 1]) {
+        sorted = 0;
+        break;
+      }
+    }
+    printf("\nMezcla en árbol (%s): %.6f segundos\n",
+           pairwise_merge ? "por parejas" : "k-way", merge_time);
+    printf("✅ Lista %sordenada correctamente\n", sorted ? "" : "NO ");
+  }
+
+  // ========== LIMPIEZA ==========
+  free(buffers[0]);
+  free(buffers[1]);
+  free(chunk_reqs);
+  free(local_data);
+
+  MPI_Finalize();
+  return 0;
+}